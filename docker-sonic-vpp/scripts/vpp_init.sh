@@ -48,12 +48,93 @@ cp $STARTUP_TMPL $TMP_FILE || error "Failed to copy template file"
 [ "$DPDK_DISABLE" == "y" ] && sed -i -e 's/plugin dpdk_plugin/#plugin dpdk_plugin/g' $TMP_FILE
 [ "$NO_LINUX_NL" == "y" ] && sed -i -e 's/plugin linux_nl_plugin/#plugin linux_nl_plugin/g' $TMP_FILE
 
+WORKERS=$(awk '$1 == "workers" { print $2 }' $TMP_FILE)
+WORKERS=${WORKERS:=0}
+
+# veth ports are attached with af_packet or AF_XDP.  VPP_VETH_MODE is the
+# mode for all of them (af_packet, the default, or af_xdp) and
+# VPP_VETH_MODES ("eth1=af_packet,eth2=af_xdp") overrides it per port.
+# Either way the port gets one RX queue per worker and keeps the
+# host-<port> name.
+VPP_VETH_MODE=${VPP_VETH_MODE:=af_packet}
+VETH_QUEUES=$((WORKERS > 0 ? WORKERS : 1))
+AF_XDP_PLUGIN=$(ls /usr/lib/*/vpp_plugins/af_xdp_plugin.so 2> /dev/null | head -1)
+xdp_ports=()
+
+function veth_mode()
+{
+    local port=$1 mode=$VPP_VETH_MODE kv
+
+    IFS=","
+    for kv in $VPP_VETH_MODES; do
+	[ "${kv%%=*}" == "$port" ] && mode=${kv#*=}
+    done
+    unset IFS
+
+    echo $mode
+}
+
+# af_packet: TPACKET_V3 rings, one RX queue per worker
+function af_packet_cmd()
+{
+    if [ $VETH_QUEUES -gt 1 ]; then
+	echo "create host-interface name $1 num-rx-queues $VETH_QUEUES"
+    else
+	echo "create host-interface name $1"
+    fi
+}
+
+# AF_XDP: zero-copy when the driver supports it, copy mode otherwise
+# (the plugin's default).  The veth gets one channel per worker, and
+# NAPI is told to stay deferred while VPP busy-polls the rings.
+function af_xdp_create()
+{
+    local port=$1
+
+    [ -n "$AF_XDP_PLUGIN" ] || return 1
+
+    ethtool -L $port rx $VETH_QUEUES tx $VETH_QUEUES >& /dev/null
+    echo 2 > /sys/class/net/$port/napi_defer_hard_irqs 2> /dev/null
+    echo 200000 > /sys/class/net/$port/gro_flush_timeout 2> /dev/null
+
+    # vppctl exits 0 on a failed command; look for the interface instead
+    vppctl create interface af_xdp host-if $port name host-$port \
+	num-rx-queues all >& /dev/null
+    vppctl show interface host-$port | grep -q "^host-$port " || return 1
+    vppctl set interface rx-mode host-$port polling
+}
+
+# AF_XDP ports are created with vppctl once VPP is up rather than from
+# the startup config, which stops at its first failing line: a port the
+# kernel or driver refuses (no XDP support, MTU too large for XDP, ...)
+# falls back to af_packet on its own and the ports after it are still
+# created.
+function create_xdp_ports()
+{
+    local port i
+
+    for i in $(seq 60); do
+	vppctl show version >& /dev/null && break
+	sleep 1
+    done
+
+    for port in ${xdp_ports[@]}; do
+	af_xdp_create $port && continue
+	echo "AF_XDP unavailable on $port, using af_packet"
+	vppctl $(af_packet_cmd $port)
+    done
+}
+
 IDX=0
 upd_startup "dpdk {"
 for port in ${portlist[@]};
 do
     if eval ip link show type veth dev $port >& /dev/null; then
-	echo "create host-interface name $port" >> $STARTUP_CFG
+	if [ "$(veth_mode $port)" == "af_xdp" ]; then
+	    xdp_ports+=($port)
+	else
+	    af_packet_cmd $port >> $STARTUP_CFG
+	fi
 	continue
     fi
     upd_startup """
@@ -75,6 +156,25 @@ echo "    buffers-per-numa $TOTBUF" >> $TMP_FILE
 [ "$DPDK_DISABLE" != "y" ] && echo "    page-size default-hugepage" >> $TMP_FILE
 echo "}" >> $TMP_FILE
 
+# One linux-cp host tap queue per thread: the RX queues are spread over
+# the workers and every thread gets a TX queue of its own, so punts and
+# host-xc traffic are not funnelled through a single virtio ring.
+# LCP_TAP_QUEUES overrides the RX count.
+LCP_RXQ=${LCP_TAP_QUEUES:=$((WORKERS > 0 ? WORKERS : 1))}
+echo "linux-cp {" >> $TMP_FILE
+echo "    num-rx-queues $LCP_RXQ" >> $TMP_FILE
+echo "    num-tx-queues $((WORKERS + 1))" >> $TMP_FILE
+echo "}" >> $TMP_FILE
+
+# Preferred march variant (hsw, skx, icl, ...) for every node built with
+# MULTIARCH_SOURCES.  Left unset, VPP picks the highest-priority variant
+# the CPU supports.
+if [ "x$VPP_NODE_VARIANT" != "x" ]; then
+    echo "node {" >> $TMP_FILE
+    echo "    default { variant $VPP_NODE_VARIANT }" >> $TMP_FILE
+    echo "}" >> $TMP_FILE
+fi
+
 if [ "$DPDK_DISABLE" != "y" ]; then
     if [ $IDX -le 6 ]; then
 	NHPG=12
@@ -86,6 +186,16 @@ fi
 
 cat $TMP_FILE
 
-/usr/bin/vpp -c ${TMP_FILE}
+if [ ${#xdp_ports[@]} -gt 0 ]; then
+    # VPP stays this script's child; the AF_XDP ports are created before
+    # the script waits on it, and a stop request is passed on to it.
+    /usr/bin/vpp -c ${TMP_FILE} &
+    VPP_PID=$!
+    trap "kill -TERM $VPP_PID" TERM INT
+    create_xdp_ports
+    wait $VPP_PID
+else
+    /usr/bin/vpp -c ${TMP_FILE}
+fi
 
 rm -f $TMP_FILE $STARTUP_CFG
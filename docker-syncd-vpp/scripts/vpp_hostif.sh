@@ -21,20 +21,38 @@ function dbg()
     fi
 }
 
+# lcp pairs waiting to be created, as "<hwif> host-if <ifname>" words.
+# They are flushed in one "sonic-ext lcp create" once the burst of create
+# messages from SONiC stops, so VPP takes the worker barrier once for all
+# of them instead of once per port.
+pending_creates=()
+
+# Host tap offloads for new pairs ("gso", "gso gro" or empty).
+LCP_TAP_OFFLOAD=${LCP_TAP_OFFLOAD-gso}
+
 function create_intf()
 {
     ifname=$1
     hwif=$2
 
-    dbg "Creating lcp interface ${ifname}"
-    if ! eval vppctl show lcp phy ${hwif} | grep ${ifname} >& /dev/null; then
-	# docker exec  ubuntu-vpp vppctl set state ${hwif} up || echo "Command failed with status $?"
-
-	vppctl lcp create ${hwif} host-if ${ifname} || dbg "lcp create command failed with status $?"
-	sleep 2
-    else
+    if vppctl show lcp phy ${hwif} | grep ${ifname} >& /dev/null; then
 	dbg "${hwif} already configured"
+	return
     fi
+
+    dbg "Queueing lcp interface ${ifname}"
+    pending_creates+=("${hwif}" host-if "${ifname}")
+}
+
+function flush_creates()
+{
+    [ ${#pending_creates[@]} -eq 0 ] && return
+
+    dbg "Creating lcp interfaces: ${pending_creates[*]}"
+    vppctl sonic-ext lcp create ${LCP_TAP_OFFLOAD} "${pending_creates[@]}" | while read line; do
+	dbg "${line}"
+    done
+    pending_creates=()
 }
 
 function set_state()
@@ -109,15 +127,28 @@ function process_sonic_msg()
 while true
 do
     echo "Listening for messages on fifo /tmp/vpp_sonic.pipe"
+    partial=""
     while true
     do
-	read cmd type sonic_msg
+	IFS= read -r -t 0.5 chunk
+	rc=$?
+	if [ ${rc} -gt 128 ]; then
+	    # Quiet for a moment: the create burst is over.  A timeout
+	    # can land mid-line; keep what was read for the next read.
+	    partial+="${chunk}"
+	    flush_creates
+	    continue
+	fi
+	read cmd type sonic_msg <<< "${partial}${chunk}"
+	partial=""
 	echo $sonic_msg
-	if [ "${sonic_msg}" == "" ]; then
+	if [ ${rc} -ne 0 -o "${sonic_msg}" == "" ]; then
 	    dbg "EOF received"
+	    flush_creates
 	    break
 	fi
 	dbg "${cmd} ${type} Received msg '${sonic_msg}'"
+	[ "${cmd}" != "create" ] && flush_creates
 	process_sonic_msg ${cmd} ${type} "${sonic_msg}"
     done < /tmp/vpp_sonic.pipe
 done
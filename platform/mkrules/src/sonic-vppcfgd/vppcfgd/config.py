@@ -141,6 +141,10 @@ class ConfigMgr(object):
         if no_linux_nl == 'y':
             self.vpp_json_cfg['plugins']['plugin']['linux_nl_plugin.so'] = 'disable'
 
+        node_variant = os.getenv('VPP_NODE_VARIANT', '')
+        if node_variant:
+            self.vpp_json_cfg['node'] = {'default': {'variant': node_variant}}
+
     def disable_dpdk_cfg(self):
         self.vpp_json_cfg['plugins']['plugin']['dpdk_plugin.so'] = 'disable'
         self.vpp_json_cfg.pop('dpdk', None)
@@ -49,9 +49,11 @@ format_ip4_validate_trace (u8 *s, va_list *args)
   _ (SRC_CLASS_E, "source address is class E")                                \
   _ (SRC_UNSPECIFIED, "source address is unspecified")                        \
   _ (SRC_LINK_LOCAL, "source address is link-local")                          \
+  _ (SRC_BOGON, "source address is a configured bogon")                      \
   _ (DST_LOOPBACK, "destination address is loopback")                        \
   _ (DST_LINK_LOCAL, "destination address is link-local")                    \
-  _ (L2_MCAST_BCAST, "unicast IP with multicast~broadcast L2 destination")
+  _ (L2_MCAST_BCAST, "unicast IP with multicast~broadcast L2 destination")   \
+  _ (SHORT_CIRCUIT, "frames short-circuited")
 
 typedef enum
 {
@@ -75,12 +77,14 @@ typedef enum
 } ip4_validate_next_t;
 
 /*
- * Validate a single IPv4 packet. Returns the error code and sets *next
- * to the appropriate next-node index (feature-arc next on success,
- * IP4_VALIDATE_NEXT_DROP on failure).
+ * Validate a single IPv4 packet against the checks set in @checks.
+ * Returns the error code and sets *next to the appropriate next-node
+ * index (feature-arc next on success, IP4_VALIDATE_NEXT_DROP on
+ * failure).  @checks is a constant in the common-profile
+ * specializations, so the disabled checks compile away.
  */
 static_always_inline ip4_validate_error_t
-ip4_validate_x1 (vlib_buffer_t *b, u16 *next)
+ip4_validate_x1 (vlib_buffer_t *b, u16 *next, u32 checks)
 {
   ip4_header_t *ip = vlib_buffer_get_current (b);
   u32 feat_next;
@@ -104,43 +108,48 @@ ip4_validate_x1 (vlib_buffer_t *b, u16 *next)
    * Use ethernet_buffer_get_header() which correctly handles VLAN-tagged
    * frames via l2_hdr_offset set by ethernet-input.
    */
-  {
-    ethernet_header_t *eth = ethernet_buffer_get_header (b);
-    if (PREDICT_FALSE (eth->dst_address[0] & 0x01))
-      {
-	*next = IP4_VALIDATE_NEXT_DROP;
-	return IP4_VALIDATE_ERROR_L2_MCAST_BCAST;
-      }
-  }
+  if (checks & IP_VALIDATE_CHECK_L2_MCAST_BCAST)
+    {
+      ethernet_header_t *eth = ethernet_buffer_get_header (b);
+      if (PREDICT_FALSE (eth->dst_address[0] & 0x01))
+	{
+	  *next = IP4_VALIDATE_NEXT_DROP;
+	  return IP4_VALIDATE_ERROR_L2_MCAST_BCAST;
+	}
+    }
 
   /* SRC checks */
 
   /* Drop packets with source in 127.0.0.0/8 (loopback range) */
-  if (PREDICT_FALSE ((src >> 24) == 127))
+  if ((checks & IP_VALIDATE_CHECK_SRC_LOOPBACK) &&
+      PREDICT_FALSE ((src >> 24) == 127))
     {
       *next = IP4_VALIDATE_NEXT_DROP;
       return IP4_VALIDATE_ERROR_SRC_LOOPBACK;
     }
   /* Drop packets with source in 224.0.0.0/4 (multicast range) */
-  if (PREDICT_FALSE ((src >> 28) == 0xE))
+  if ((checks & IP_VALIDATE_CHECK_SRC_MULTICAST) &&
+      PREDICT_FALSE ((src >> 28) == 0xE))
     {
       *next = IP4_VALIDATE_NEXT_DROP;
       return IP4_VALIDATE_ERROR_SRC_MULTICAST;
     }
   /* Drop packets with source in 240.0.0.0/4 (class E reserved range) */
-  if (PREDICT_FALSE ((src >> 28) == 0xF))
+  if ((checks & IP_VALIDATE_CHECK_SRC_CLASS_E) &&
+      PREDICT_FALSE ((src >> 28) == 0xF))
     {
       *next = IP4_VALIDATE_NEXT_DROP;
       return IP4_VALIDATE_ERROR_SRC_CLASS_E;
     }
   /* Drop packets with source 0.0.0.0 (unspecified address) */
-  if (PREDICT_FALSE (src == 0))
+  if ((checks & IP_VALIDATE_CHECK_SRC_UNSPECIFIED) && PREDICT_FALSE (src == 0))
     {
       *next = IP4_VALIDATE_NEXT_DROP;
       return IP4_VALIDATE_ERROR_SRC_UNSPECIFIED;
     }
   /* Drop packets with source in 169.254.0.0/16 (link-local range) */
-  if (PREDICT_FALSE ((src >> 16) == 0xA9FE))
+  if ((checks & IP_VALIDATE_CHECK_SRC_LINK_LOCAL) &&
+      PREDICT_FALSE ((src >> 16) == 0xA9FE))
     {
       *next = IP4_VALIDATE_NEXT_DROP;
       return IP4_VALIDATE_ERROR_SRC_LINK_LOCAL;
@@ -149,13 +158,15 @@ ip4_validate_x1 (vlib_buffer_t *b, u16 *next)
   /* DST checks */
 
   /* Drop packets with destination in 127.0.0.0/8 (loopback range) */
-  if (PREDICT_FALSE ((dst >> 24) == 127))
+  if ((checks & IP_VALIDATE_CHECK_DST_LOOPBACK) &&
+      PREDICT_FALSE ((dst >> 24) == 127))
     {
       *next = IP4_VALIDATE_NEXT_DROP;
       return IP4_VALIDATE_ERROR_DST_LOOPBACK;
     }
   /* Drop packets with destination in 169.254.0.0/16 (link-local range) */
-  if (PREDICT_FALSE ((dst >> 16) == 0xA9FE))
+  if ((checks & IP_VALIDATE_CHECK_DST_LINK_LOCAL) &&
+      PREDICT_FALSE ((dst >> 16) == 0xA9FE))
     {
       *next = IP4_VALIDATE_NEXT_DROP;
       return IP4_VALIDATE_ERROR_DST_LINK_LOCAL;
@@ -166,6 +177,209 @@ ip4_validate_x1 (vlib_buffer_t *b, u16 *next)
   return IP4_VALIDATE_ERROR_VALID;
 }
 
+/* Drop reason (per-interface counter) of each error */
+static const u8 ip4_validate_error_reason[IP4_VALIDATE_N_ERROR] = {
+  [IP4_VALIDATE_ERROR_L2_MCAST_BCAST] = IP_VALIDATE_REASON_L2_MCAST_BCAST,
+  [IP4_VALIDATE_ERROR_SRC_LOOPBACK] = IP_VALIDATE_REASON_SRC_LOOPBACK,
+  [IP4_VALIDATE_ERROR_SRC_MULTICAST] = IP_VALIDATE_REASON_SRC_MULTICAST,
+  [IP4_VALIDATE_ERROR_SRC_CLASS_E] = IP_VALIDATE_REASON_SRC_CLASS_E,
+  [IP4_VALIDATE_ERROR_SRC_UNSPECIFIED] = IP_VALIDATE_REASON_SRC_UNSPECIFIED,
+  [IP4_VALIDATE_ERROR_SRC_LINK_LOCAL] = IP_VALIDATE_REASON_SRC_LINK_LOCAL,
+  [IP4_VALIDATE_ERROR_SRC_BOGON] = IP_VALIDATE_REASON_SRC_BOGON,
+  [IP4_VALIDATE_ERROR_DST_LOOPBACK] = IP_VALIDATE_REASON_DST_LOOPBACK,
+  [IP4_VALIDATE_ERROR_DST_LINK_LOCAL] = IP_VALIDATE_REASON_DST_LINK_LOCAL,
+};
+
+/* ip4_validate_x1, counting a drop against the receiving interface */
+static_always_inline ip4_validate_error_t
+ip4_validate_one (vlib_main_t *vm, vlib_buffer_t *b, u16 *next, u32 checks)
+{
+  ip4_validate_error_t e = ip4_validate_x1 (b, next, checks);
+
+  if (PREDICT_FALSE (e != IP4_VALIDATE_ERROR_VALID))
+    ip_validate_count_drop (vm, b, ip4_validate_error_reason[e]);
+  return e;
+}
+
+/*
+ * Drop the packets that passed the fixed checks but whose source is in
+ * the bogon set of the interface they came in on.  The candidates are
+ * gathered first and then looked up four at a time, each mtrie step
+ * issued for all four so that their ply loads overlap.
+ */
+static_always_inline void
+ip4_validate_bogons (vlib_main_t *vm, vlib_buffer_t **b, u16 *next, u32 n,
+		     u32 *error_counts, int per_if)
+{
+  ip_validate_main_t *sm = &ip_validate_main;
+  const ip4_mtrie_8_t *mtrie[VLIB_FRAME_SIZE];
+  ip4_address_t src[VLIB_FRAME_SIZE];
+  u16 cand[VLIB_FRAME_SIZE];
+  u32 hit[VLIB_FRAME_SIZE];
+  ip_validate_bogon_set_t *set = 0;
+  u32 i, n_cand = 0, rx = ~0;
+
+  for (i = 0; i < n; i++)
+    {
+      ip4_header_t *ip;
+      u32 dst;
+
+      if (next[i] == IP4_VALIDATE_NEXT_DROP)
+	continue;
+      if (vnet_buffer (b[i])->sw_if_index[VLIB_RX] != rx)
+	{
+	  rx = vnet_buffer (b[i])->sw_if_index[VLIB_RX];
+	  set = ip_validate_bogon_set (rx);
+	  if (per_if &&
+	      !(ip_validate_checks (rx) & IP_VALIDATE_CHECK_SRC_BOGON))
+	    set = 0;
+	}
+      if (!set || set->n_bogons == 0)
+	continue;
+
+      /* as in ip4_validate_x1, only unicast is validated */
+      ip = vlib_buffer_get_current (b[i]);
+      dst = clib_net_to_host_u32 (ip->dst_address.as_u32);
+      if (PREDICT_FALSE (dst == 0xFFFFFFFFu || (dst >> 28) == 0xE))
+	continue;
+
+      cand[n_cand] = i;
+      src[n_cand] = ip->src_address;
+      mtrie[n_cand] = &set->mtrie;
+      n_cand++;
+    }
+
+  for (i = 0; i + 4 <= n_cand; i += 4)
+    {
+      ip4_mtrie_leaf_t l0, l1, l2, l3;
+
+      l0 = ip4_mtrie_8_lookup_step_one (mtrie[i + 0], &src[i + 0]);
+      l1 = ip4_mtrie_8_lookup_step_one (mtrie[i + 1], &src[i + 1]);
+      l2 = ip4_mtrie_8_lookup_step_one (mtrie[i + 2], &src[i + 2]);
+      l3 = ip4_mtrie_8_lookup_step_one (mtrie[i + 3], &src[i + 3]);
+
+      for (int byte = 1; byte < 4; byte++)
+	{
+	  l0 = ip4_mtrie_8_lookup_step (l0, &src[i + 0], byte);
+	  l1 = ip4_mtrie_8_lookup_step (l1, &src[i + 1], byte);
+	  l2 = ip4_mtrie_8_lookup_step (l2, &src[i + 2], byte);
+	  l3 = ip4_mtrie_8_lookup_step (l3, &src[i + 3], byte);
+	}
+
+      hit[i + 0] = ip4_mtrie_leaf_get_adj_index (l0);
+      hit[i + 1] = ip4_mtrie_leaf_get_adj_index (l1);
+      hit[i + 2] = ip4_mtrie_leaf_get_adj_index (l2);
+      hit[i + 3] = ip4_mtrie_leaf_get_adj_index (l3);
+    }
+
+  for (; i < n_cand; i++)
+    {
+      ip4_mtrie_leaf_t l0;
+
+      l0 = ip4_mtrie_8_lookup_step_one (mtrie[i], &src[i]);
+      for (int byte = 1; byte < 4; byte++)
+	l0 = ip4_mtrie_8_lookup_step (l0, &src[i], byte);
+      hit[i] = ip4_mtrie_leaf_get_adj_index (l0);
+    }
+
+  for (i = 0; i < n_cand; i++)
+    {
+      if (PREDICT_TRUE (hit[i] == 0))
+	continue;
+
+      next[cand[i]] = IP4_VALIDATE_NEXT_DROP;
+      error_counts[IP4_VALIDATE_ERROR_VALID]--;
+      error_counts[IP4_VALIDATE_ERROR_SRC_BOGON]++;
+      ip_validate_count_drop (vm, b[cand[i]], IP_VALIDATE_REASON_SRC_BOGON);
+      vlib_increment_simple_counter (&sm->bogon_hits, vm->thread_index,
+				     hit[i] - 1, 1);
+    }
+}
+
+#if defined(CLIB_HAVE_VEC256)
+/*
+ * Validate eight packets at once.  The addresses and the L2 dst I/G bit
+ * of all eight are gathered into u32x8 lanes and every check in @checks
+ * is evaluated as a lane mask, in network byte order so nothing needs
+ * swapping.  Lanes that pass all checks (the common case by far) just
+ * take the feature-arc next; only a failing lane goes through
+ * ip4_validate_x1 to find out which check it failed.  Returns the
+ * number of valid packets.
+ */
+static_always_inline u32
+ip4_validate_x8 (vlib_main_t *vm, vlib_buffer_t **b, u16 *next,
+		 u32 *error_counts, u32 checks)
+{
+  u32 src[8], dst[8], l2mc[8];
+  u32x8 vs, vd, skip, bad = {};
+  u32 lane_mask, n_bad;
+  int i;
+
+  for (i = 0; i < 8; i++)
+    {
+      ip4_header_t *ip = vlib_buffer_get_current (b[i]);
+      src[i] = ip->src_address.as_u32;
+      dst[i] = ip->dst_address.as_u32;
+      if (checks & IP_VALIDATE_CHECK_L2_MCAST_BCAST)
+	l2mc[i] = ethernet_buffer_get_header (b[i])->dst_address[0] & 0x01;
+    }
+
+  vs = u32x8_load_unaligned (src);
+  vd = u32x8_load_unaligned (dst);
+
+#define IP4_VALIDATE_NET(x) u32x8_splat (clib_host_to_net_u32 (x))
+#define IP4_VALIDATE_IN(v, mask, val)                                         \
+  ((u32x8) (((v) & IP4_VALIDATE_NET (mask)) == IP4_VALIDATE_NET (val)))
+
+  /* Broadcast and multicast destinations are not validated */
+  skip = (u32x8) (vd == u32x8_splat (0xFFFFFFFFu)) |
+	 IP4_VALIDATE_IN (vd, 0xF0000000, 0xE0000000);
+
+  if (checks & IP_VALIDATE_CHECK_L2_MCAST_BCAST)
+    bad |= (u32x8) (u32x8_load_unaligned (l2mc) != u32x8_splat (0));
+  if (checks & IP_VALIDATE_CHECK_SRC_LOOPBACK)
+    bad |= IP4_VALIDATE_IN (vs, 0xFF000000, 0x7F000000);
+  if (checks & IP_VALIDATE_CHECK_SRC_MULTICAST)
+    bad |= IP4_VALIDATE_IN (vs, 0xF0000000, 0xE0000000);
+  if (checks & IP_VALIDATE_CHECK_SRC_CLASS_E)
+    bad |= IP4_VALIDATE_IN (vs, 0xF0000000, 0xF0000000);
+  if (checks & IP_VALIDATE_CHECK_SRC_UNSPECIFIED)
+    bad |= (u32x8) (vs == u32x8_splat (0));
+  if (checks & IP_VALIDATE_CHECK_SRC_LINK_LOCAL)
+    bad |= IP4_VALIDATE_IN (vs, 0xFFFF0000, 0xA9FE0000);
+  if (checks & IP_VALIDATE_CHECK_DST_LOOPBACK)
+    bad |= IP4_VALIDATE_IN (vd, 0xFF000000, 0x7F000000);
+  if (checks & IP_VALIDATE_CHECK_DST_LINK_LOCAL)
+    bad |= IP4_VALIDATE_IN (vd, 0xFFFF0000, 0xA9FE0000);
+
+#undef IP4_VALIDATE_IN
+#undef IP4_VALIDATE_NET
+
+  bad &= ~skip;
+
+  if (PREDICT_TRUE (u32x8_is_all_zero (bad)))
+    {
+      for (i = 0; i < 8; i++)
+	vnet_feature_next_u16 (&next[i], b[i]);
+      return 8;
+    }
+
+  /* one bit per byte of the mask; keep the low bit of each lane */
+  lane_mask = u8x32_msb_mask ((u8x32) bad) & 0x11111111;
+  n_bad = count_set_bits (lane_mask);
+
+  for (i = 0; i < 8; i++)
+    {
+      if (lane_mask & (1 << (4 * i)))
+	error_counts[ip4_validate_one (vm, b[i], &next[i], checks)]++;
+      else
+	vnet_feature_next_u16 (&next[i], b[i]);
+    }
+
+  return 8 - n_bad;
+}
+#endif
+
 static_always_inline void
 ip4_validate_trace_one (vlib_main_t *vm, vlib_node_runtime_t *node,
 			      vlib_buffer_t *b, u16 next)
@@ -182,21 +396,48 @@ ip4_validate_trace_one (vlib_main_t *vm, vlib_node_runtime_t *node,
     }
 }
 
-VLIB_NODE_FN (ip4_validate_node)
-(vlib_main_t *vm, vlib_node_runtime_t *node, vlib_frame_t *frame)
+/* The checks for packet @b: the frame's profile, or its own
+ * interface's if the frame is mixed. */
+#define IP4_VALIDATE_CHECKS(b)                                                \
+  (per_if ? ip_validate_checks (vnet_buffer (b)->sw_if_index[VLIB_RX]) &     \
+	      IP_VALIDATE_CHECKS_IP4 :                                        \
+	    checks)
+
+static_always_inline uword
+ip4_validate_inline (vlib_main_t *vm, vlib_node_runtime_t *node,
+		     vlib_frame_t *frame, vlib_buffer_t **bufs, u32 checks,
+		     int per_if)
 {
   u32 n_left_from, *from;
-  vlib_buffer_t *bufs[VLIB_FRAME_SIZE], **b;
+  vlib_buffer_t **b;
   u16 nexts[VLIB_FRAME_SIZE], *next;
   u32 error_counts[IP4_VALIDATE_N_ERROR] = { 0 };
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
-
-  vlib_get_buffers (vm, from, bufs, n_left_from);
   b = bufs;
   next = nexts;
 
+#if defined(CLIB_HAVE_VEC256)
+  while (!per_if && n_left_from >= 8)
+    {
+      if (n_left_from >= 24)
+	{
+	  for (int i = 16; i < 24; i++)
+	    vlib_prefetch_buffer_header (b[i], LOAD);
+	  for (int i = 8; i < 16; i++)
+	    vlib_prefetch_buffer_data (b[i], LOAD);
+	}
+
+      error_counts[IP4_VALIDATE_ERROR_VALID] +=
+	ip4_validate_x8 (vm, b, next, error_counts, checks);
+
+      b += 8;
+      next += 8;
+      n_left_from -= 8;
+    }
+#endif
+
 #if (CLIB_N_PREFETCHES >= 8)
   while (n_left_from >= 4)
     {
@@ -213,18 +454,14 @@ VLIB_NODE_FN (ip4_validate_node)
 	  vlib_prefetch_buffer_data (b[7], LOAD);
 	}
 
-      error_counts[ip4_validate_x1 (b[0], &next[0])]++;
-      error_counts[ip4_validate_x1 (b[1], &next[1])]++;
-      error_counts[ip4_validate_x1 (b[2], &next[2])]++;
-      error_counts[ip4_validate_x1 (b[3], &next[3])]++;
-
-      if (PREDICT_FALSE (node->flags & VLIB_NODE_FLAG_TRACE))
-	{
-	  ip4_validate_trace_one (vm, node, b[0], next[0]);
-	  ip4_validate_trace_one (vm, node, b[1], next[1]);
-	  ip4_validate_trace_one (vm, node, b[2], next[2]);
-	  ip4_validate_trace_one (vm, node, b[3], next[3]);
-	}
+      error_counts[ip4_validate_one (vm, b[0], &next[0],
+				     IP4_VALIDATE_CHECKS (b[0]))]++;
+      error_counts[ip4_validate_one (vm, b[1], &next[1],
+				     IP4_VALIDATE_CHECKS (b[1]))]++;
+      error_counts[ip4_validate_one (vm, b[2], &next[2],
+				     IP4_VALIDATE_CHECKS (b[2]))]++;
+      error_counts[ip4_validate_one (vm, b[3], &next[3],
+				     IP4_VALIDATE_CHECKS (b[3]))]++;
 
       b += 4;
       next += 4;
@@ -234,25 +471,25 @@ VLIB_NODE_FN (ip4_validate_node)
 
   while (n_left_from)
     {
-      error_counts[ip4_validate_x1 (b[0], &next[0])]++;
-
-      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE) &&
-			 (b[0]->flags & VLIB_BUFFER_IS_TRACED)))
-	{
-	  ip4_header_t *ip = vlib_buffer_get_current (b[0]);
-	  ip4_validate_trace_t *t =
-	    vlib_add_trace (vm, node, b[0], sizeof (*t));
-	  t->sw_if_index = vnet_buffer (b[0])->sw_if_index[VLIB_RX];
-	  t->next_index = next[0];
-	  t->src_addr = ip->src_address.as_u32;
-	  t->dst_addr = ip->dst_address.as_u32;
-	}
+      error_counts[ip4_validate_one (vm, b[0], &next[0],
+				     IP4_VALIDATE_CHECKS (b[0]))]++;
 
       b += 1;
       next += 1;
       n_left_from -= 1;
     }
 
+  /* A mixed frame checks each packet's own profile for src-bogon */
+  if ((per_if || (checks & IP_VALIDATE_CHECK_SRC_BOGON)) &&
+      PREDICT_FALSE (ip_validate_main.n_bogons))
+    ip4_validate_bogons (vm, bufs, nexts, frame->n_vectors, error_counts,
+			 per_if);
+
+  /* Traced last, so the next of a bogon drop is the drop */
+  if (PREDICT_FALSE (node->flags & VLIB_NODE_FLAG_TRACE))
+    for (int i = 0; i < frame->n_vectors; i++)
+      ip4_validate_trace_one (vm, node, bufs[i], nexts[i]);
+
   vlib_buffer_enqueue_to_next (vm, node, from, nexts, frame->n_vectors);
 
   for (int i = 0; i < IP4_VALIDATE_N_ERROR; i++)
@@ -265,6 +502,105 @@ VLIB_NODE_FN (ip4_validate_node)
   return frame->n_vectors;
 }
 
+#undef IP4_VALIDATE_CHECKS
+
+/*
+ * True if no packet of the frame can fail @checks, the profile all of
+ * them share.  Only the L2 and bogon checks depend on where a packet
+ * came in: the L2 one cannot fail without an Ethernet header, nor the
+ * bogon one with an empty set.  Any address check can fail, so the
+ * usual profiles are turned down by the first test.
+ */
+static_always_inline int
+ip4_validate_frame_cannot_fail (vlib_buffer_t **b, u32 n, u32 checks)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  u32 i, rx = ~0;
+
+  if (PREDICT_TRUE (checks & ~(IP_VALIDATE_CHECK_L2_MCAST_BCAST |
+			       IP_VALIDATE_CHECK_SRC_BOGON)))
+    return 0;
+  if (!(checks & IP_VALIDATE_CHECK_L2_MCAST_BCAST) &&
+      !(checks & IP_VALIDATE_CHECK_SRC_BOGON && ip_validate_main.n_bogons))
+    return 1;
+
+  for (i = 0; i < n; i++)
+    {
+      if (vnet_buffer (b[i])->sw_if_index[VLIB_RX] == rx)
+	continue;
+      rx = vnet_buffer (b[i])->sw_if_index[VLIB_RX];
+
+      if ((checks & IP_VALIDATE_CHECK_L2_MCAST_BCAST) &&
+	  ethernet_get_interface (&ethernet_main,
+				  vnet_get_sup_hw_interface (vnm, rx)
+				    ->hw_if_index))
+	return 0;
+      if ((checks & IP_VALIDATE_CHECK_SRC_BOGON) &&
+	  ip_validate_bogon_set (rx)->n_bogons)
+	return 0;
+    }
+
+  return 1;
+}
+
+/* Pass a frame that cannot fail straight on without parsing it */
+static_always_inline uword
+ip4_validate_short_circuit (vlib_main_t *vm, vlib_node_runtime_t *node,
+			    vlib_frame_t *frame, vlib_buffer_t **bufs)
+{
+  u16 nexts[VLIB_FRAME_SIZE];
+  u32 i;
+
+  for (i = 0; i < frame->n_vectors; i++)
+    vnet_feature_next_u16 (&nexts[i], bufs[i]);
+
+  if (PREDICT_FALSE (node->flags & VLIB_NODE_FLAG_TRACE))
+    for (i = 0; i < frame->n_vectors; i++)
+      ip4_validate_trace_one (vm, node, bufs[i], nexts[i]);
+
+  vlib_buffer_enqueue_to_next (vm, node, vlib_frame_vector_args (frame),
+			       nexts, frame->n_vectors);
+
+  vlib_node_increment_counter (vm, ip4_validate_node.index,
+			       IP4_VALIDATE_ERROR_VALID, frame->n_vectors);
+  vlib_node_increment_counter (vm, ip4_validate_node.index,
+			       IP4_VALIDATE_ERROR_SHORT_CIRCUIT, 1);
+
+  return frame->n_vectors;
+}
+
+/*
+ * Frames are checked with a single profile whenever all their packets
+ * came in on interfaces with the same one.  The full and source-only
+ * profiles get specializations of their own with the check mask a
+ * constant; any other profile is a run-time mask, and a frame mixing
+ * profiles looks each packet's up.  A frame none of whose packets can
+ * fail its profile is not looked at at all.
+ */
+VLIB_NODE_FN (ip4_validate_node)
+(vlib_main_t *vm, vlib_node_runtime_t *node, vlib_frame_t *frame)
+{
+  vlib_buffer_t *bufs[VLIB_FRAME_SIZE];
+  u32 checks;
+
+  vlib_get_buffers (vm, vlib_frame_vector_args (frame), bufs,
+		    frame->n_vectors);
+  checks =
+    ip_validate_frame_checks (bufs, frame->n_vectors, IP_VALIDATE_CHECKS_IP4);
+
+  if (PREDICT_TRUE (checks == IP_VALIDATE_CHECKS_IP4))
+    return ip4_validate_inline (vm, node, frame, bufs, IP_VALIDATE_CHECKS_IP4,
+				0);
+  if (checks == IP_VALIDATE_CHECKS_SRC)
+    return ip4_validate_inline (vm, node, frame, bufs, IP_VALIDATE_CHECKS_SRC,
+				0);
+  if (checks == IP_VALIDATE_CHECKS_MIXED)
+    return ip4_validate_inline (vm, node, frame, bufs, 0, 1);
+  if (ip4_validate_frame_cannot_fail (bufs, frame->n_vectors, checks))
+    return ip4_validate_short_circuit (vm, node, frame, bufs);
+  return ip4_validate_inline (vm, node, frame, bufs, checks, 0);
+}
+
 VLIB_REGISTER_NODE (ip4_validate_node) = {
   .name = "ip4-validate",
   .vector_size = sizeof (u32),
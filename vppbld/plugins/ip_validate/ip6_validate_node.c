@@ -72,34 +72,82 @@ typedef enum
   IP6_VALIDATE_N_NEXT,
 } ip6_validate_next_t;
 
-static_always_inline int
-ip6_validate_address_is_zero (const ip6_address_t *a)
+/* Classes of an IPv6 address, as far as the checks are concerned */
+#define IP6_VALIDATE_ADDR_MULTICAST   (1 << 0)
+#define IP6_VALIDATE_ADDR_UNSPECIFIED (1 << 1)
+#define IP6_VALIDATE_ADDR_LOOPBACK    (1 << 2)
+
+/*
+ * Classify an address with a single compare: one u8x16 compare against
+ * zero gives a bitmap of its zero bytes, and :: and ::1 are then a
+ * compare of that bitmap (plus the last byte for ::1).  No branches.
+ */
+static_always_inline u32
+ip6_validate_address_class (const ip6_address_t *a)
+{
+  u32 zero;
+
+#ifdef CLIB_HAVE_VEC128
+  zero = u8x16_msb_mask (
+    (u8x16) (u8x16_load_unaligned (a->as_u8) == u8x16_splat (0)));
+#else
+  zero = 0;
+  for (int i = 0; i < 16; i++)
+    zero |= (a->as_u8[i] == 0) << i;
+#endif
+
+  return (a->as_u8[0] == 0xFF) * IP6_VALIDATE_ADDR_MULTICAST |
+	 (zero == 0xFFFF) * IP6_VALIDATE_ADDR_UNSPECIFIED |
+	 (zero == 0x7FFF && a->as_u8[15] == 1) * IP6_VALIDATE_ADDR_LOOPBACK;
+}
+
+/* The source and destination classes that fail @checks */
+static_always_inline u32
+ip6_validate_src_classes (u32 checks)
 {
-  return (a->as_u64[0] == 0 && a->as_u64[1] == 0);
+  u32 classes = 0;
+
+  if (checks & IP_VALIDATE_CHECK_SRC_MULTICAST)
+    classes |= IP6_VALIDATE_ADDR_MULTICAST;
+  if (checks & IP_VALIDATE_CHECK_SRC_UNSPECIFIED)
+    classes |= IP6_VALIDATE_ADDR_UNSPECIFIED;
+  if (checks & IP_VALIDATE_CHECK_SRC_LOOPBACK)
+    classes |= IP6_VALIDATE_ADDR_LOOPBACK;
+  return classes;
 }
 
-static_always_inline int
-ip6_validate_address_is_loopback (const ip6_address_t *a)
+static_always_inline u32
+ip6_validate_dst_classes (u32 checks)
 {
-  return (a->as_u64[0] == 0 && a->as_u64[1] == clib_host_to_net_u64 (1));
+  u32 classes = 0;
+
+  if (checks & IP_VALIDATE_CHECK_DST_UNSPECIFIED)
+    classes |= IP6_VALIDATE_ADDR_UNSPECIFIED;
+  if (checks & IP_VALIDATE_CHECK_DST_LOOPBACK)
+    classes |= IP6_VALIDATE_ADDR_LOOPBACK;
+  return classes;
 }
 
 /*
- * Validate a single IPv6 packet. Returns the error code and sets *next
- * to the appropriate next-node index (feature-arc next on success,
- * IP6_VALIDATE_NEXT_DROP on failure).
+ * Validate a single IPv6 packet against the checks set in @checks.
+ * Returns the error code and sets *next to the appropriate next-node
+ * index (feature-arc next on success, IP6_VALIDATE_NEXT_DROP on
+ * failure).  @checks is a constant in the common-profile
+ * specializations, so the disabled checks compile away.
  */
 static_always_inline ip6_validate_error_t
-ip6_validate_x1 (vlib_buffer_t *b, u16 *next)
+ip6_validate_x1 (vlib_buffer_t *b, u16 *next, u32 checks)
 {
   ip6_header_t *ip = vlib_buffer_get_current (b);
   u32 feat_next;
+  u32 src_class, dst_class;
 
   vnet_feature_next (&feat_next, b);
 
   /* Only validate unicast packets */
   /* skip multicast (ff00::/8) */
-  if (PREDICT_FALSE (ip->dst_address.as_u8[0] == 0xFF))
+  dst_class = ip6_validate_address_class (&ip->dst_address);
+  if (PREDICT_FALSE (dst_class & IP6_VALIDATE_ADDR_MULTICAST))
     {
       *next = (u16) feat_next;
       return IP6_VALIDATE_ERROR_VALID;
@@ -110,31 +158,36 @@ ip6_validate_x1 (vlib_buffer_t *b, u16 *next)
    * Use ethernet_buffer_get_header() which correctly handles VLAN-tagged
    * frames via l2_hdr_offset set by ethernet-input.
    */
-  {
-    ethernet_header_t *eth = ethernet_buffer_get_header (b);
-    if (PREDICT_FALSE (eth->dst_address[0] & 0x01))
-      {
-	*next = IP6_VALIDATE_NEXT_DROP;
-	return IP6_VALIDATE_ERROR_L2_MCAST_BCAST;
-      }
-  }
+  if (checks & IP_VALIDATE_CHECK_L2_MCAST_BCAST)
+    {
+      ethernet_header_t *eth = ethernet_buffer_get_header (b);
+      if (PREDICT_FALSE (eth->dst_address[0] & 0x01))
+	{
+	  *next = IP6_VALIDATE_NEXT_DROP;
+	  return IP6_VALIDATE_ERROR_L2_MCAST_BCAST;
+	}
+    }
 
   /* SRC checks */
+  src_class = ip6_validate_address_class (&ip->src_address);
 
   /* Drop packets with source in ff00::/8 (multicast range) */
-  if (PREDICT_FALSE (ip->src_address.as_u8[0] == 0xFF))
+  if ((checks & IP_VALIDATE_CHECK_SRC_MULTICAST) &&
+      PREDICT_FALSE (src_class & IP6_VALIDATE_ADDR_MULTICAST))
     {
       *next = IP6_VALIDATE_NEXT_DROP;
       return IP6_VALIDATE_ERROR_SRC_MULTICAST;
     }
   /* Drop packets with source :: (unspecified address) */
-  if (PREDICT_FALSE (ip6_validate_address_is_zero (&ip->src_address)))
+  if ((checks & IP_VALIDATE_CHECK_SRC_UNSPECIFIED) &&
+      PREDICT_FALSE (src_class & IP6_VALIDATE_ADDR_UNSPECIFIED))
     {
       *next = IP6_VALIDATE_NEXT_DROP;
       return IP6_VALIDATE_ERROR_SRC_UNSPECIFIED;
     }
   /* Drop packets with source ::1 (loopback address) */
-  if (PREDICT_FALSE (ip6_validate_address_is_loopback (&ip->src_address)))
+  if ((checks & IP_VALIDATE_CHECK_SRC_LOOPBACK) &&
+      PREDICT_FALSE (src_class & IP6_VALIDATE_ADDR_LOOPBACK))
     {
       *next = IP6_VALIDATE_NEXT_DROP;
       return IP6_VALIDATE_ERROR_SRC_LOOPBACK;
@@ -143,13 +196,15 @@ ip6_validate_x1 (vlib_buffer_t *b, u16 *next)
   /* DST checks */
 
   /* Drop packets with destination :: (unspecified address) */
-  if (PREDICT_FALSE (ip6_validate_address_is_zero (&ip->dst_address)))
+  if ((checks & IP_VALIDATE_CHECK_DST_UNSPECIFIED) &&
+      PREDICT_FALSE (dst_class & IP6_VALIDATE_ADDR_UNSPECIFIED))
     {
       *next = IP6_VALIDATE_NEXT_DROP;
       return IP6_VALIDATE_ERROR_DST_UNSPECIFIED;
     }
   /* Drop packets with destination ::1 (loopback address) */
-  if (PREDICT_FALSE (ip6_validate_address_is_loopback (&ip->dst_address)))
+  if ((checks & IP_VALIDATE_CHECK_DST_LOOPBACK) &&
+      PREDICT_FALSE (dst_class & IP6_VALIDATE_ADDR_LOOPBACK))
     {
       *next = IP6_VALIDATE_NEXT_DROP;
       return IP6_VALIDATE_ERROR_DST_LOOPBACK;
@@ -160,6 +215,79 @@ ip6_validate_x1 (vlib_buffer_t *b, u16 *next)
   return IP6_VALIDATE_ERROR_VALID;
 }
 
+/* Drop reason (per-interface counter) of each error */
+static const u8 ip6_validate_error_reason[IP6_VALIDATE_N_ERROR] = {
+  [IP6_VALIDATE_ERROR_L2_MCAST_BCAST] = IP_VALIDATE_REASON_L2_MCAST_BCAST,
+  [IP6_VALIDATE_ERROR_SRC_MULTICAST] = IP_VALIDATE_REASON_SRC_MULTICAST,
+  [IP6_VALIDATE_ERROR_SRC_UNSPECIFIED] = IP_VALIDATE_REASON_SRC_UNSPECIFIED,
+  [IP6_VALIDATE_ERROR_SRC_LOOPBACK] = IP_VALIDATE_REASON_SRC_LOOPBACK,
+  [IP6_VALIDATE_ERROR_DST_UNSPECIFIED] = IP_VALIDATE_REASON_DST_UNSPECIFIED,
+  [IP6_VALIDATE_ERROR_DST_LOOPBACK] = IP_VALIDATE_REASON_DST_LOOPBACK,
+};
+
+/* ip6_validate_x1, counting a drop against the receiving interface */
+static_always_inline ip6_validate_error_t
+ip6_validate_one (vlib_main_t *vm, vlib_buffer_t *b, u16 *next, u32 checks)
+{
+  ip6_validate_error_t e = ip6_validate_x1 (b, next, checks);
+
+  if (PREDICT_FALSE (e != IP6_VALIDATE_ERROR_VALID))
+    ip_validate_count_drop (vm, b, ip6_validate_error_reason[e]);
+  return e;
+}
+
+/*
+ * Validate eight packets at once.  Each address is classified with one
+ * vector compare and a packet fails if its classes intersect the ones
+ * @checks rejects; lanes that pass (the common case by far) just take
+ * the feature-arc next and only a failing lane goes through
+ * ip6_validate_x1 to find out which check it failed.  Returns the
+ * number of valid packets.
+ */
+static_always_inline u32
+ip6_validate_x8 (vlib_main_t *vm, vlib_buffer_t **b, u16 *next,
+		 u32 *error_counts, u32 checks)
+{
+  u32 src_bad = ip6_validate_src_classes (checks);
+  u32 dst_bad = ip6_validate_dst_classes (checks);
+  u32 lane_mask = 0;
+  int i;
+
+  for (i = 0; i < 8; i++)
+    {
+      ip6_header_t *ip = vlib_buffer_get_current (b[i]);
+      u32 dst_class = ip6_validate_address_class (&ip->dst_address);
+      u32 bad = (ip6_validate_address_class (&ip->src_address) & src_bad) |
+		(dst_class & dst_bad);
+
+      if (checks & IP_VALIDATE_CHECK_L2_MCAST_BCAST)
+	bad |= ethernet_buffer_get_header (b[i])->dst_address[0] & 0x01;
+
+      /* multicast destinations are not validated */
+      if (dst_class & IP6_VALIDATE_ADDR_MULTICAST)
+	bad = 0;
+
+      lane_mask |= (bad != 0) << i;
+    }
+
+  if (PREDICT_TRUE (lane_mask == 0))
+    {
+      for (i = 0; i < 8; i++)
+	vnet_feature_next_u16 (&next[i], b[i]);
+      return 8;
+    }
+
+  for (i = 0; i < 8; i++)
+    {
+      if (lane_mask & (1 << i))
+	error_counts[ip6_validate_one (vm, b[i], &next[i], checks)]++;
+      else
+	vnet_feature_next_u16 (&next[i], b[i]);
+    }
+
+  return 8 - count_set_bits (lane_mask);
+}
+
 static_always_inline void
 ip6_validate_trace_one (vlib_main_t *vm, vlib_node_runtime_t *node,
 			      vlib_buffer_t *b, u16 next)
@@ -178,21 +306,46 @@ ip6_validate_trace_one (vlib_main_t *vm, vlib_node_runtime_t *node,
     }
 }
 
-VLIB_NODE_FN (ip6_validate_node)
-(vlib_main_t *vm, vlib_node_runtime_t *node, vlib_frame_t *frame)
+/* The checks for packet @b: the frame's profile, or its own
+ * interface's if the frame is mixed. */
+#define IP6_VALIDATE_CHECKS(b)                                                \
+  (per_if ? ip_validate_checks (vnet_buffer (b)->sw_if_index[VLIB_RX]) &     \
+	      IP_VALIDATE_CHECKS_IP6 :                                        \
+	    checks)
+
+static_always_inline uword
+ip6_validate_inline (vlib_main_t *vm, vlib_node_runtime_t *node,
+		     vlib_frame_t *frame, vlib_buffer_t **bufs, u32 checks,
+		     int per_if)
 {
   u32 n_left_from, *from;
-  vlib_buffer_t *bufs[VLIB_FRAME_SIZE], **b;
+  vlib_buffer_t **b;
   u16 nexts[VLIB_FRAME_SIZE], *next;
   u32 error_counts[IP6_VALIDATE_N_ERROR] = { 0 };
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
-
-  vlib_get_buffers (vm, from, bufs, n_left_from);
   b = bufs;
   next = nexts;
 
+  while (!per_if && n_left_from >= 8)
+    {
+      if (n_left_from >= 24)
+	{
+	  for (int i = 16; i < 24; i++)
+	    vlib_prefetch_buffer_header (b[i], LOAD);
+	  for (int i = 8; i < 16; i++)
+	    vlib_prefetch_buffer_data (b[i], LOAD);
+	}
+
+      error_counts[IP6_VALIDATE_ERROR_VALID] +=
+	ip6_validate_x8 (vm, b, next, error_counts, checks);
+
+      b += 8;
+      next += 8;
+      n_left_from -= 8;
+    }
+
 #if (CLIB_N_PREFETCHES >= 8)
   while (n_left_from >= 4)
     {
@@ -209,18 +362,14 @@ VLIB_NODE_FN (ip6_validate_node)
 	  vlib_prefetch_buffer_data (b[7], LOAD);
 	}
 
-      error_counts[ip6_validate_x1 (b[0], &next[0])]++;
-      error_counts[ip6_validate_x1 (b[1], &next[1])]++;
-      error_counts[ip6_validate_x1 (b[2], &next[2])]++;
-      error_counts[ip6_validate_x1 (b[3], &next[3])]++;
-
-      if (PREDICT_FALSE (node->flags & VLIB_NODE_FLAG_TRACE))
-	{
-	  ip6_validate_trace_one (vm, node, b[0], next[0]);
-	  ip6_validate_trace_one (vm, node, b[1], next[1]);
-	  ip6_validate_trace_one (vm, node, b[2], next[2]);
-	  ip6_validate_trace_one (vm, node, b[3], next[3]);
-	}
+      error_counts[ip6_validate_one (vm, b[0], &next[0],
+				     IP6_VALIDATE_CHECKS (b[0]))]++;
+      error_counts[ip6_validate_one (vm, b[1], &next[1],
+				     IP6_VALIDATE_CHECKS (b[1]))]++;
+      error_counts[ip6_validate_one (vm, b[2], &next[2],
+				     IP6_VALIDATE_CHECKS (b[2]))]++;
+      error_counts[ip6_validate_one (vm, b[3], &next[3],
+				     IP6_VALIDATE_CHECKS (b[3]))]++;
 
       b += 4;
       next += 4;
@@ -230,27 +379,18 @@ VLIB_NODE_FN (ip6_validate_node)
 
   while (n_left_from)
     {
-      error_counts[ip6_validate_x1 (b[0], &next[0])]++;
-
-      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE) &&
-			 (b[0]->flags & VLIB_BUFFER_IS_TRACED)))
-	{
-	  ip6_header_t *ip = vlib_buffer_get_current (b[0]);
-	  ip6_validate_trace_t *t =
-	    vlib_add_trace (vm, node, b[0], sizeof (*t));
-	  t->sw_if_index = vnet_buffer (b[0])->sw_if_index[VLIB_RX];
-	  t->next_index = next[0];
-	  clib_memcpy_fast (&t->src_addr, &ip->src_address,
-			    sizeof (ip6_address_t));
-	  clib_memcpy_fast (&t->dst_addr, &ip->dst_address,
-			    sizeof (ip6_address_t));
-	}
+      error_counts[ip6_validate_one (vm, b[0], &next[0],
+				     IP6_VALIDATE_CHECKS (b[0]))]++;
 
       b += 1;
       next += 1;
       n_left_from -= 1;
     }
 
+  if (PREDICT_FALSE (node->flags & VLIB_NODE_FLAG_TRACE))
+    for (int i = 0; i < frame->n_vectors; i++)
+      ip6_validate_trace_one (vm, node, bufs[i], nexts[i]);
+
   vlib_buffer_enqueue_to_next (vm, node, from, nexts, frame->n_vectors);
 
   for (int i = 0; i < IP6_VALIDATE_N_ERROR; i++)
@@ -263,6 +403,32 @@ VLIB_NODE_FN (ip6_validate_node)
   return frame->n_vectors;
 }
 
+#undef IP6_VALIDATE_CHECKS
+
+/* Profile dispatch as in ip4-validate */
+VLIB_NODE_FN (ip6_validate_node)
+(vlib_main_t *vm, vlib_node_runtime_t *node, vlib_frame_t *frame)
+{
+  vlib_buffer_t *bufs[VLIB_FRAME_SIZE];
+  u32 checks;
+
+  vlib_get_buffers (vm, vlib_frame_vector_args (frame), bufs,
+		    frame->n_vectors);
+  checks =
+    ip_validate_frame_checks (bufs, frame->n_vectors, IP_VALIDATE_CHECKS_IP6);
+
+  if (PREDICT_TRUE (checks == IP_VALIDATE_CHECKS_IP6))
+    return ip6_validate_inline (vm, node, frame, bufs, IP_VALIDATE_CHECKS_IP6,
+				0);
+  if (checks == (IP_VALIDATE_CHECKS_SRC & IP_VALIDATE_CHECKS_IP6))
+    return ip6_validate_inline (vm, node, frame, bufs,
+				IP_VALIDATE_CHECKS_SRC & IP_VALIDATE_CHECKS_IP6,
+				0);
+  if (checks == IP_VALIDATE_CHECKS_MIXED)
+    return ip6_validate_inline (vm, node, frame, bufs, 0, 1);
+  return ip6_validate_inline (vm, node, frame, bufs, checks, 0);
+}
+
 VLIB_REGISTER_NODE (ip6_validate_node) = {
   .name = "ip6-validate",
   .vector_size = sizeof (u32),
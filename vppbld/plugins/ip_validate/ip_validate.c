@@ -32,10 +32,238 @@ VLIB_PLUGIN_REGISTER () = {
 
 ip_validate_main_t ip_validate_main;
 
+#define _(bit, sym, str)                                                      \
+  STATIC_ASSERT ((u32) IP_VALIDATE_API_CHECK_##sym ==                         \
+                   IP_VALIDATE_CHECK_##sym,                                   \
+                 "ip_validate.api check " #sym " out of sync");
+foreach_ip_validate_check
+#undef _
+
+static int
+ip_validate_feature_enable_disable (u32 sw_if_index, int is_enable)
+{
+  int rv;
+
+  rv = vnet_feature_enable_disable ("ip4-unicast", "ip4-validate",
+                                    sw_if_index, is_enable, 0, 0);
+  if (rv)
+    return rv;
+
+  rv = vnet_feature_enable_disable ("ip6-unicast", "ip6-validate",
+                                    sw_if_index, is_enable, 0, 0);
+  if (rv)
+    {
+      /* Rollback ip4 to avoid half-enabled state */
+      vnet_feature_enable_disable ("ip4-unicast", "ip4-validate",
+                                   sw_if_index, !is_enable, 0, 0);
+    }
+  return rv;
+}
+
+/*
+ * Set the checks run on packets received on an interface.  The
+ * features are on the arcs exactly while the profile is non-empty, so
+ * an interface with validation off does not even pay the arc hop.
+ */
+int
+ip_validate_set_checks (u32 sw_if_index, u32 checks)
+{
+  ip_validate_main_t *sm = &ip_validate_main;
+  int rv;
+
+  checks &= IP_VALIDATE_CHECKS_ALL;
+  vec_validate_init_empty (sm->checks_by_sw_if_index, sw_if_index, 0);
+
+  if ((sm->checks_by_sw_if_index[sw_if_index] != 0) != (checks != 0))
+    {
+      rv = ip_validate_feature_enable_disable (sw_if_index, checks != 0);
+      if (rv)
+        return rv;
+    }
+
+  sm->checks_by_sw_if_index[sw_if_index] = checks;
+  return 0;
+}
+
+static uword
+ip_validate_bogon_key (const ip4_address_t *addr, u8 len)
+{
+  return ((u64) addr->as_u32 << 8) | len;
+}
+
+static u32
+ip_validate_bogon_set_find_or_add (u32 set_id)
+{
+  ip_validate_main_t *sm = &ip_validate_main;
+  ip_validate_bogon_set_t *set;
+  uword *p;
+
+  p = hash_get (sm->bogon_set_index_by_id, set_id);
+  if (p)
+    return p[0];
+
+  pool_get_zero (sm->bogon_sets, set);
+  set->set_id = set_id;
+  ip4_mtrie_8_init (&set->mtrie);
+  hash_set (sm->bogon_set_index_by_id, set_id, set - sm->bogon_sets);
+
+  return set - sm->bogon_sets;
+}
+
+/*
+ * Add or delete a bogon prefix in a set, creating the set on its first
+ * add.  A prefix's mtrie leaves point at the bogon itself, so its hits
+ * are counted per prefix; on delete they fall back to the longest
+ * shorter bogon in the set that covers it, if there is one.
+ */
+int
+ip_validate_bogon_add_del (u32 set_id, const ip4_address_t *addr, u8 len,
+                           int is_add)
+{
+  ip_validate_main_t *sm = &ip_validate_main;
+  ip_validate_bogon_set_t *set;
+  ip_validate_bogon_t *bogon;
+  ip4_address_t a, cover;
+  u32 set_index, bogon_index;
+  uword *p, *q = 0;
+  int cover_len;
+
+  if (len > 32)
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  if (!is_add && !hash_get (sm->bogon_set_index_by_id, set_id))
+    return VNET_API_ERROR_NO_SUCH_TABLE;
+
+  set_index = ip_validate_bogon_set_find_or_add (set_id);
+  set = pool_elt_at_index (sm->bogon_sets, set_index);
+  a.as_u32 = addr->as_u32 & ip4_main.fib_masks[len];
+  p = hash_get (set->bogon_by_prefix, ip_validate_bogon_key (&a, len));
+
+  if (is_add)
+    {
+      if (p)
+        return VNET_API_ERROR_VALUE_EXIST;
+
+      pool_get_zero (sm->bogons, bogon);
+      bogon->addr = a;
+      bogon->len = len;
+      bogon->set_index = set_index;
+      bogon_index = bogon - sm->bogons;
+
+      vlib_validate_simple_counter (&sm->bogon_hits, bogon_index);
+      vlib_zero_simple_counter (&sm->bogon_hits, bogon_index);
+
+      hash_set (set->bogon_by_prefix, ip_validate_bogon_key (&a, len),
+                bogon_index);
+      ip4_mtrie_8_route_add (&set->mtrie, &a, len, bogon_index + 1);
+      set->n_bogons++;
+      sm->n_bogons++;
+      return 0;
+    }
+
+  if (!p)
+    return VNET_API_ERROR_NO_SUCH_ENTRY;
+  bogon_index = p[0];
+
+  for (cover_len = len - 1; cover_len >= 0; cover_len--)
+    {
+      cover.as_u32 = a.as_u32 & ip4_main.fib_masks[cover_len];
+      q = hash_get (set->bogon_by_prefix,
+                    ip_validate_bogon_key (&cover, cover_len));
+      if (q)
+        break;
+    }
+
+  ip4_mtrie_8_route_del (&set->mtrie, &a, len, bogon_index + 1,
+                         q ? cover_len : 0, q ? q[0] + 1 : 0);
+  hash_unset (set->bogon_by_prefix, ip_validate_bogon_key (&a, len));
+  pool_put_index (sm->bogons, bogon_index);
+  set->n_bogons--;
+  sm->n_bogons--;
+  return 0;
+}
+
+/* Look packets received on an interface up in a bogon set */
+int
+ip_validate_bogon_set_bind (u32 sw_if_index, u32 set_id)
+{
+  ip_validate_main_t *sm = &ip_validate_main;
+
+  vec_validate_init_empty (sm->bogon_set_by_sw_if_index, sw_if_index, 0);
+  sm->bogon_set_by_sw_if_index[sw_if_index] =
+    ip_validate_bogon_set_find_or_add (set_id);
+  return 0;
+}
+
+static char *ip_validate_check_names[] = {
+#define _(bit, sym, str) [bit] = str,
+  foreach_ip_validate_check
+#undef _
+};
+
+u8 *
+format_ip_validate_checks (u8 *s, va_list *args)
+{
+  u32 checks = va_arg (*args, u32);
+  char *sep = "";
+  u32 bit;
+
+  if (checks == 0)
+    return format (s, "off");
+  if (checks == IP_VALIDATE_CHECKS_ALL)
+    return format (s, "all");
+  if (checks == IP_VALIDATE_CHECKS_SRC)
+    return format (s, "src");
+
+  for (bit = 0; bit < ARRAY_LEN (ip_validate_check_names); bit++)
+    if (checks & (1 << bit))
+      {
+        s = format (s, "%s%s", sep, ip_validate_check_names[bit]);
+        sep = " ";
+      }
+
+  return s;
+}
+
+/* all | off | src | <check> [<check> ...] */
+uword
+unformat_ip_validate_checks (unformat_input_t *input, va_list *args)
+{
+  u32 *checks = va_arg (*args, u32 *);
+  u32 c = 0, bit;
+
+  /* the check names first: "src" is a prefix of several of them */
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      for (bit = 0; bit < ARRAY_LEN (ip_validate_check_names); bit++)
+        if (unformat (input, ip_validate_check_names[bit]))
+          break;
+      if (bit == ARRAY_LEN (ip_validate_check_names))
+        break;
+      c |= 1 << bit;
+    }
+
+  if (c == 0)
+    {
+      if (unformat (input, "all"))
+        c = IP_VALIDATE_CHECKS_ALL;
+      else if (unformat (input, "off"))
+        c = 0;
+      else if (unformat (input, "src"))
+        c = IP_VALIDATE_CHECKS_SRC;
+      else
+        return 0;
+    }
+
+  *checks = c;
+  return 1;
+}
+
 /*
  * API handler — currently used only by the test suite.
  * Production behaviour is automatic: the VNET_SW_INTERFACE_ADD_DEL_FUNCTION
  * callback enables validation on every interface when it is created.
+ * Enable / disable is the "all" / "off" profile.
  */
 static void
 vl_api_ip_validate_enable_disable_t_handler (
@@ -45,29 +273,304 @@ vl_api_ip_validate_enable_disable_t_handler (
   vl_api_ip_validate_enable_disable_reply_t *rmp;
   int rv = 0;
   u32 sw_if_index = ntohl (mp->sw_if_index);
-  int is_enable = mp->is_enable;
 
   VALIDATE_SW_IF_INDEX (mp);
 
-  rv = vnet_feature_enable_disable ("ip4-unicast", "ip4-validate",
-                                    sw_if_index, is_enable, 0, 0);
-  if (rv)
-    goto done;
+  rv = ip_validate_set_checks (sw_if_index,
+                               mp->is_enable ? IP_VALIDATE_CHECKS_ALL : 0);
 
-  rv = vnet_feature_enable_disable ("ip6-unicast", "ip6-validate",
-                                    sw_if_index, is_enable, 0, 0);
-  if (rv)
+  BAD_SW_IF_INDEX_LABEL;
+  REPLY_MACRO (VL_API_IP_VALIDATE_ENABLE_DISABLE_REPLY);
+}
+
+static void
+vl_api_ip_validate_set_profile_t_handler (
+  vl_api_ip_validate_set_profile_t *mp)
+{
+  ip_validate_main_t *sm = &ip_validate_main;
+  vl_api_ip_validate_set_profile_reply_t *rmp;
+  int rv = 0;
+
+  VALIDATE_SW_IF_INDEX (mp);
+
+  rv = ip_validate_set_checks (ntohl (mp->sw_if_index), ntohl (mp->checks));
+
+  BAD_SW_IF_INDEX_LABEL;
+  REPLY_MACRO (VL_API_IP_VALIDATE_SET_PROFILE_REPLY);
+}
+
+static void
+send_ip_validate_profile_details (vl_api_registration_t *reg, u32 context,
+                                  u32 sw_if_index)
+{
+  vl_api_ip_validate_profile_details_t *mp;
+
+  mp = vl_msg_api_alloc_zero (sizeof (*mp));
+  mp->_vl_msg_id = htons (VL_API_IP_VALIDATE_PROFILE_DETAILS +
+                          ip_validate_main.msg_id_base);
+  mp->context = context;
+  mp->sw_if_index = htonl (sw_if_index);
+  mp->checks = htonl (ip_validate_checks (sw_if_index));
+  mp->bogon_set_id = htonl (ip_validate_bogon_set (sw_if_index)->set_id);
+
+  vl_api_send_msg (reg, (u8 *) mp);
+}
+
+static void
+vl_api_ip_validate_profile_dump_t_handler (
+  vl_api_ip_validate_profile_dump_t *mp)
+{
+  vnet_interface_main_t *im = &vnet_get_main ()->interface_main;
+  vl_api_registration_t *reg;
+  vnet_sw_interface_t *si;
+  u32 sw_if_index = ntohl (mp->sw_if_index);
+
+  reg = vl_api_client_index_to_registration (mp->client_index);
+  if (!reg)
+    return;
+
+  if (sw_if_index != ~0)
     {
-      /* Rollback ip4 to avoid half-enabled state */
-      vnet_feature_enable_disable ("ip4-unicast", "ip4-validate",
-                                   sw_if_index, !is_enable, 0, 0);
+      if (!pool_is_free_index (im->sw_interfaces, sw_if_index))
+        send_ip_validate_profile_details (reg, mp->context, sw_if_index);
+      return;
     }
 
-done:
+  pool_foreach (si, im->sw_interfaces)
+    send_ip_validate_profile_details (reg, mp->context, si->sw_if_index);
+}
+
+static void
+vl_api_ip_validate_bogon_add_del_t_handler (
+  vl_api_ip_validate_bogon_add_del_t *mp)
+{
+  ip_validate_main_t *sm = &ip_validate_main;
+  vl_api_ip_validate_bogon_add_del_reply_t *rmp;
+  ip4_address_t addr;
+  int rv;
+
+  clib_memcpy (&addr, mp->prefix.address, sizeof (addr));
+  rv = ip_validate_bogon_add_del (ntohl (mp->set_id), &addr, mp->prefix.len,
+                                  mp->is_add);
+
+  REPLY_MACRO (VL_API_IP_VALIDATE_BOGON_ADD_DEL_REPLY);
+}
+
+static void
+vl_api_ip_validate_bogon_set_bind_t_handler (
+  vl_api_ip_validate_bogon_set_bind_t *mp)
+{
+  ip_validate_main_t *sm = &ip_validate_main;
+  vl_api_ip_validate_bogon_set_bind_reply_t *rmp;
+  int rv = 0;
+
+  VALIDATE_SW_IF_INDEX (mp);
+
+  rv = ip_validate_bogon_set_bind (ntohl (mp->sw_if_index),
+                                   ntohl (mp->set_id));
+
   BAD_SW_IF_INDEX_LABEL;
-  REPLY_MACRO (VL_API_IP_VALIDATE_ENABLE_DISABLE_REPLY);
+  REPLY_MACRO (VL_API_IP_VALIDATE_BOGON_SET_BIND_REPLY);
+}
+
+static void
+send_ip_validate_bogon_details (vl_api_registration_t *reg, u32 context,
+                                u32 bogon_index)
+{
+  ip_validate_main_t *sm = &ip_validate_main;
+  vl_api_ip_validate_bogon_details_t *mp;
+  ip_validate_bogon_t *bogon = pool_elt_at_index (sm->bogons, bogon_index);
+
+  mp = vl_msg_api_alloc_zero (sizeof (*mp));
+  mp->_vl_msg_id =
+    htons (VL_API_IP_VALIDATE_BOGON_DETAILS + sm->msg_id_base);
+  mp->context = context;
+  mp->set_id =
+    htonl (pool_elt_at_index (sm->bogon_sets, bogon->set_index)->set_id);
+  clib_memcpy (mp->prefix.address, &bogon->addr, sizeof (bogon->addr));
+  mp->prefix.len = bogon->len;
+  mp->hits =
+    clib_host_to_net_u64 (vlib_get_simple_counter (&sm->bogon_hits,
+                                                   bogon_index));
+
+  vl_api_send_msg (reg, (u8 *) mp);
 }
 
+static void
+vl_api_ip_validate_bogon_dump_t_handler (vl_api_ip_validate_bogon_dump_t *mp)
+{
+  ip_validate_main_t *sm = &ip_validate_main;
+  vl_api_registration_t *reg;
+  ip_validate_bogon_t *bogon;
+  u32 set_id = ntohl (mp->set_id);
+
+  reg = vl_api_client_index_to_registration (mp->client_index);
+  if (!reg)
+    return;
+
+  pool_foreach (bogon, sm->bogons)
+    {
+      if (set_id != ~0 &&
+          pool_elt_at_index (sm->bogon_sets, bogon->set_index)->set_id !=
+            set_id)
+        continue;
+      send_ip_validate_bogon_details (reg, mp->context,
+                                      bogon - sm->bogons);
+    }
+}
+
+static clib_error_t *
+set_interface_ip_validate_command_fn (vlib_main_t *vm,
+                                      unformat_input_t *input,
+                                      vlib_cli_command_t *cmd)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  u32 sw_if_index = ~0, checks = ~0, set_id = ~0;
+  int rv;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (sw_if_index == ~0 &&
+          unformat (input, "%U", unformat_vnet_sw_interface, vnm,
+                    &sw_if_index))
+        ;
+      else if (unformat (input, "bogon-set %u", &set_id))
+        ;
+      else if (checks == ~0 &&
+               unformat (input, "%U", unformat_ip_validate_checks, &checks))
+        ;
+      else
+        return clib_error_return (0, "unknown input `%U'",
+                                  format_unformat_error, input);
+    }
+
+  if (sw_if_index == ~0)
+    return clib_error_return (0, "interface required");
+  if (checks == ~0 && set_id == ~0)
+    return clib_error_return (0, "profile or bogon set required");
+
+  if (set_id != ~0)
+    ip_validate_bogon_set_bind (sw_if_index, set_id);
+
+  if (checks != ~0)
+    {
+      rv = ip_validate_set_checks (sw_if_index, checks);
+      if (rv)
+        return clib_error_return (0, "%U", format_vnet_api_errno, rv);
+    }
+
+  return 0;
+}
+
+VLIB_CLI_COMMAND (set_interface_ip_validate_command, static) = {
+  .path = "set interface ip validate",
+  .short_help = "set interface ip validate <interface> "
+                "[all | off | src | <check> [<check> ...]] "
+                "[bogon-set <id>]",
+  .function = set_interface_ip_validate_command_fn,
+};
+
+static clib_error_t *
+ip_validate_bogon_command_fn (vlib_main_t *vm, unformat_input_t *input,
+                              vlib_cli_command_t *cmd)
+{
+  ip4_address_t addr;
+  u32 len = ~0, set_id = 0;
+  int is_add = 1, rv;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "add"))
+        is_add = 1;
+      else if (unformat (input, "del"))
+        is_add = 0;
+      else if (unformat (input, "%U/%u", unformat_ip4_address, &addr, &len))
+        ;
+      else if (unformat (input, "set %u", &set_id))
+        ;
+      else
+        return clib_error_return (0, "unknown input `%U'",
+                                  format_unformat_error, input);
+    }
+
+  if (len == ~0)
+    return clib_error_return (0, "prefix required");
+  if (len > 32)
+    return clib_error_return (0, "bad prefix length %u", len);
+
+  rv = ip_validate_bogon_add_del (set_id, &addr, len, is_add);
+  if (rv)
+    return clib_error_return (0, "%U", format_vnet_api_errno, rv);
+
+  return 0;
+}
+
+VLIB_CLI_COMMAND (ip_validate_bogon_command, static) = {
+  .path = "ip validate bogon",
+  .short_help = "ip validate bogon [add|del] <prefix> [set <id>]",
+  .function = ip_validate_bogon_command_fn,
+};
+
+static clib_error_t *
+show_ip_validate_bogons_command_fn (vlib_main_t *vm, unformat_input_t *input,
+                                    vlib_cli_command_t *cmd)
+{
+  ip_validate_main_t *sm = &ip_validate_main;
+  ip_validate_bogon_set_t *set;
+  ip_validate_bogon_t *bogon;
+
+  pool_foreach (set, sm->bogon_sets)
+    {
+      vlib_cli_output (vm, "bogon-set %u: %u prefixes", set->set_id,
+                       set->n_bogons);
+      pool_foreach (bogon, sm->bogons)
+        if (bogon->set_index == set - sm->bogon_sets)
+          vlib_cli_output (
+            vm, "  %U/%u %lu hits", format_ip4_address, &bogon->addr,
+            bogon->len,
+            vlib_get_simple_counter (&sm->bogon_hits, bogon - sm->bogons));
+    }
+
+  return 0;
+}
+
+VLIB_CLI_COMMAND (show_ip_validate_bogons_command, static) = {
+  .path = "show ip validate bogons",
+  .short_help = "show ip validate bogons",
+  .function = show_ip_validate_bogons_command_fn,
+};
+
+static clib_error_t *
+show_ip_validate_command_fn (vlib_main_t *vm, unformat_input_t *input,
+                             vlib_cli_command_t *cmd)
+{
+  ip_validate_main_t *sm = &ip_validate_main;
+  vnet_main_t *vnm = vnet_get_main ();
+  vnet_sw_interface_t *si;
+  u64 n;
+  u32 r;
+
+  pool_foreach (si, vnm->interface_main.sw_interfaces)
+    {
+      vlib_cli_output (vm, "%-32U %U bogon-set %u",
+                       format_vnet_sw_if_index_name, vnm, si->sw_if_index,
+                       format_ip_validate_checks,
+                       ip_validate_checks (si->sw_if_index),
+                       ip_validate_bogon_set (si->sw_if_index)->set_id);
+      for (r = 0; r < IP_VALIDATE_N_REASONS; r++)
+        if ((n = vlib_get_simple_counter (&sm->drops[r], si->sw_if_index)))
+          vlib_cli_output (vm, "  %-30s %lu drops", sm->drops[r].name, n);
+    }
+
+  return 0;
+}
+
+VLIB_CLI_COMMAND (show_ip_validate_command, static) = {
+  .path = "show ip validate",
+  .short_help = "show ip validate",
+  .function = show_ip_validate_command_fn,
+};
+
 /* API definitions */
 #include <ip_validate/ip_validate.api.c>
 
@@ -78,25 +581,55 @@ ip_validate_init (vlib_main_t *vm)
 
   sm->msg_id_base = setup_message_id_table ();
 
+  /* Interfaces seen so far (local0) were added before the counters
+   * had their stats segment names, so validate them all now. */
+#define _(bit, sym, str)                                                      \
+  sm->drops[bit].name = str;                                                  \
+  sm->drops[bit].stat_segment_name = "/ip-validate/" str;                     \
+  vlib_validate_simple_counter (&sm->drops[bit],                              \
+                                vec_len (sm->checks_by_sw_if_index));         \
+  vlib_zero_simple_counter (&sm->drops[bit], 0);
+  foreach_ip_validate_check
+#undef _
+  sm->drops_ready = 1;
+
+  sm->bogon_hits.name = "bogon-hits";
+  sm->bogon_hits.stat_segment_name = "/ip-validate/bogon-hits";
+  ip_validate_bogon_set_find_or_add (0);
+
   return 0;
 }
 
-VLIB_INIT_FUNCTION (ip_validate_init);
+VLIB_INIT_FUNCTION (ip_validate_init) = {
+  /* the bogon sets' mtrie plies come from its pool */
+  .runs_after = VLIB_INITS ("ip4_mtrie_module_init"),
+};
 
 /*
  * Auto-enable validation on every interface as it is created.
  * This is the intended production mechanism — no explicit API call is
- * needed.  The ip_validate_enable_disable API exists for testing
- * and could serve as a per-interface override in the future if needed.
+ * needed.  ip_validate_set_profile narrows or turns off the checks per
+ * interface afterwards.
  */
 static clib_error_t *
 ip_validate_sw_interface_add_del (vnet_main_t *vnm, u32 sw_if_index,
                                         u32 is_add)
 {
-  vnet_feature_enable_disable ("ip4-unicast", "ip4-validate",
-                               sw_if_index, is_add, 0, 0);
-  vnet_feature_enable_disable ("ip6-unicast", "ip6-validate",
-                               sw_if_index, is_add, 0, 0);
+  ip_validate_main_t *sm = &ip_validate_main;
+  u32 r;
+
+  if (is_add && sm->drops_ready)
+    for (r = 0; r < IP_VALIDATE_N_REASONS; r++)
+      {
+        vlib_validate_simple_counter (&sm->drops[r], sw_if_index);
+        vlib_zero_simple_counter (&sm->drops[r], sw_if_index);
+      }
+
+  /* back to the default bogon set */
+  if (sw_if_index < vec_len (sm->bogon_set_by_sw_if_index))
+    sm->bogon_set_by_sw_if_index[sw_if_index] = 0;
+
+  ip_validate_set_checks (sw_if_index, is_add ? IP_VALIDATE_CHECKS_ALL : 0);
   return 0;
 }
 
@@ -17,15 +17,176 @@
 
 #include <vnet/vnet.h>
 #include <vnet/ip/ip.h>
+#include <vnet/ip/ip4_mtrie.h>
+
+/*
+ * Per-interface validation checks.  The L2, loopback and unspecified
+ * checks apply to both families, class E, link-local and the bogon set
+ * to IPv4 only, and a check that does not exist for a family is ignored
+ * there.
+ */
+#define foreach_ip_validate_check                                             \
+  _ (0, L2_MCAST_BCAST, "l2-mcast")                                           \
+  _ (1, SRC_LOOPBACK, "src-loopback")                                         \
+  _ (2, SRC_MULTICAST, "src-multicast")                                       \
+  _ (3, SRC_UNSPECIFIED, "src-unspecified")                                   \
+  _ (4, SRC_CLASS_E, "src-class-e")                                           \
+  _ (5, SRC_LINK_LOCAL, "src-link-local")                                     \
+  _ (6, DST_LOOPBACK, "dst-loopback")                                         \
+  _ (7, DST_UNSPECIFIED, "dst-unspecified")                                   \
+  _ (8, DST_LINK_LOCAL, "dst-link-local")                                     \
+  _ (9, SRC_BOGON, "src-bogon")
+
+typedef enum
+{
+#define _(bit, sym, str) IP_VALIDATE_CHECK_##sym = (1 << bit),
+  foreach_ip_validate_check
+#undef _
+} ip_validate_check_t;
+
+/* A failed check is also the drop reason */
+typedef enum
+{
+#define _(bit, sym, str) IP_VALIDATE_REASON_##sym = bit,
+  foreach_ip_validate_check
+#undef _
+    IP_VALIDATE_N_REASONS,
+} ip_validate_reason_t;
+
+/* Profiles.  ALL is what every interface gets when it is created; SRC
+ * is source-address (anti-spoofing) checks only; a profile of 0 takes
+ * the interface off the feature arcs altogether. */
+#define IP_VALIDATE_CHECKS_ALL 0x3ff
+#define IP_VALIDATE_CHECKS_SRC                                                \
+  (IP_VALIDATE_CHECK_SRC_LOOPBACK | IP_VALIDATE_CHECK_SRC_MULTICAST |         \
+   IP_VALIDATE_CHECK_SRC_UNSPECIFIED | IP_VALIDATE_CHECK_SRC_CLASS_E |        \
+   IP_VALIDATE_CHECK_SRC_LINK_LOCAL | IP_VALIDATE_CHECK_SRC_BOGON)
+#define IP_VALIDATE_CHECKS_IP4                                                \
+  (IP_VALIDATE_CHECKS_ALL & ~IP_VALIDATE_CHECK_DST_UNSPECIFIED)
+#define IP_VALIDATE_CHECKS_IP6                                                \
+  (IP_VALIDATE_CHECKS_ALL &                                                   \
+   ~(IP_VALIDATE_CHECK_SRC_CLASS_E | IP_VALIDATE_CHECK_SRC_LINK_LOCAL |       \
+     IP_VALIDATE_CHECK_DST_LINK_LOCAL | IP_VALIDATE_CHECK_SRC_BOGON))
+
+/* ip_validate_frame_checks: the frame's packets come from interfaces
+ * with different profiles */
+#define IP_VALIDATE_CHECKS_MIXED (~0)
+
+/* An operator-configured IPv4 bogon prefix */
+typedef struct
+{
+  ip4_address_t addr;
+  u8 len;
+  /* index of the set it is in */
+  u32 set_index;
+} ip_validate_bogon_t;
+
+/*
+ * A set of bogon prefixes, bound to any number of interfaces.  The
+ * mtrie's leaves hold the index of the longest matching bogon plus one,
+ * so an empty leaf (0) is a miss.
+ */
+typedef struct
+{
+  u32 set_id;
+  u32 n_bogons;
+  ip4_mtrie_8_t mtrie;
+  /* bogon index by ip_validate_bogon_key () */
+  uword *bogon_by_prefix;
+} ip_validate_bogon_set_t;
 
 typedef struct
 {
   /* API message ID base */
   u16 msg_id_base;
+
+  /* Checks per sw_if_index; the features are enabled on exactly the
+   * interfaces with a non-zero entry */
+  u32 *checks_by_sw_if_index;
+
+  /* Drops per reason, per thread and per receiving sw_if_index, in the
+   * stats segment as /ip-validate/<reason> */
+  vlib_simple_counter_main_t drops[IP_VALIDATE_N_REASONS];
+  u8 drops_ready;
+
+  /* Bogon sets, by pool index; set 0 always exists and is the one
+   * every interface starts out bound to */
+  ip_validate_bogon_set_t *bogon_sets;
+  uword *bogon_set_index_by_id;
+  u32 *bogon_set_by_sw_if_index;
+
+  /* Bogons in all sets, and their hits in /ip-validate/bogon-hits */
+  ip_validate_bogon_t *bogons;
+  vlib_simple_counter_main_t bogon_hits;
+  u32 n_bogons;
 } ip_validate_main_t;
 
 extern ip_validate_main_t ip_validate_main;
 
+int ip_validate_set_checks (u32 sw_if_index, u32 checks);
+int ip_validate_bogon_add_del (u32 set_id, const ip4_address_t *addr, u8 len,
+			       int is_add);
+int ip_validate_bogon_set_bind (u32 sw_if_index, u32 set_id);
+format_function_t format_ip_validate_checks;
+unformat_function_t unformat_ip_validate_checks;
+
+static_always_inline u32
+ip_validate_checks (u32 sw_if_index)
+{
+  u32 *checks = ip_validate_main.checks_by_sw_if_index;
+
+  if (PREDICT_FALSE (sw_if_index >= vec_len (checks)))
+    return IP_VALIDATE_CHECKS_ALL;
+  return checks[sw_if_index];
+}
+
+/* The bogon set packets received on @sw_if_index are looked up in */
+static_always_inline ip_validate_bogon_set_t *
+ip_validate_bogon_set (u32 sw_if_index)
+{
+  ip_validate_main_t *sm = &ip_validate_main;
+  u32 set_index = 0;
+
+  if (PREDICT_TRUE (sw_if_index < vec_len (sm->bogon_set_by_sw_if_index)))
+    set_index = sm->bogon_set_by_sw_if_index[sw_if_index];
+  return pool_elt_at_index (sm->bogon_sets, set_index);
+}
+
+static_always_inline void
+ip_validate_count_drop (vlib_main_t *vm, vlib_buffer_t *b,
+			ip_validate_reason_t reason)
+{
+  vlib_increment_simple_counter (&ip_validate_main.drops[reason],
+				 vm->thread_index,
+				 vnet_buffer (b)->sw_if_index[VLIB_RX], 1);
+}
+
+/*
+ * The profile every packet of the frame is checked with, or
+ * IP_VALIDATE_CHECKS_MIXED if they arrived on interfaces with different
+ * profiles.  Frames on the unicast arcs nearly always come from a single
+ * interface, so this is usually one table load.
+ */
+static_always_inline u32
+ip_validate_frame_checks (vlib_buffer_t **b, u32 n, u32 family_checks)
+{
+  u32 rx = vnet_buffer (b[0])->sw_if_index[VLIB_RX];
+  u32 checks = ip_validate_checks (rx) & family_checks;
+  u32 i;
+
+  for (i = 1; i < n; i++)
+    {
+      u32 rx1 = vnet_buffer (b[i])->sw_if_index[VLIB_RX];
+      if (rx1 != rx)
+	{
+	  if ((ip_validate_checks (rx1) & family_checks) != checks)
+	    return IP_VALIDATE_CHECKS_MIXED;
+	  rx = rx1;
+	}
+    }
+  return checks;
+}
+
 extern vlib_node_registration_t ip4_validate_node;
 extern vlib_node_registration_t ip6_validate_node;
 
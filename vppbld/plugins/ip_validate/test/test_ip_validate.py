@@ -7,10 +7,13 @@ These nodes drop packets with invalid source/destination addresses
 and mismatched L2/L3 headers.
 """
 
+import platform
 import unittest
+from config import config
 from framework import VppTestCase
 from asfframework import VppTestRunner
 from vpp_sub_interface import VppDot1QSubint
+from node_bench import bench_node, assert_clocks_within
 
 from scapy.layers.l2 import Ether, Dot1Q
 from scapy.layers.inet import IP, UDP
@@ -528,6 +531,210 @@ class TestIpValidate(VppTestCase):
             pkt, "/err/ip6-validate/source address is multicast"
         )
 
+    # ================================================================
+    # Per-interface profiles
+    # ================================================================
+
+    def test_profile_src_only(self):
+        """Source-only profile passes a loopback destination"""
+        pg0 = self.pg_interfaces[0]
+        src_only = 0x2 | 0x4 | 0x8 | 0x10 | 0x20 | 0x200
+
+        self.vapi.ip_validate_set_profile(
+            sw_if_index=pg0.sw_if_index, checks=src_only
+        )
+        try:
+            details = self.vapi.ip_validate_profile_dump(
+                sw_if_index=pg0.sw_if_index
+            )
+            self.assertEqual(len(details), 1)
+            self.assertEqual(int(details[0].checks), src_only)
+
+            self.send_and_assert_passed_validate(
+                self.create_ipv4_packet(
+                    src_ip=pg0.remote_ip4, dst_ip="127.0.0.1"
+                ),
+                "ip4-validate",
+            )
+            self.send_and_assert_dropped(
+                self.create_ipv4_packet(src_ip="127.0.0.1", dst_ip=None),
+                "/err/ip4-validate/source address is loopback",
+            )
+        finally:
+            self.vapi.ip_validate_set_profile(
+                sw_if_index=pg0.sw_if_index, checks=0x3FF
+            )
+
+    def test_profile_off_leaves_arc(self):
+        """An empty profile takes the interface off the unicast arcs"""
+        pg0 = self.pg_interfaces[0]
+
+        self.vapi.ip_validate_set_profile(sw_if_index=pg0.sw_if_index, checks=0)
+        try:
+            reply = self.vapi.cli("show interface features %s" % pg0.name)
+            self.assertNotIn("ip4-validate", reply)
+            self.assertNotIn("ip6-validate", reply)
+        finally:
+            self.vapi.ip_validate_set_profile(
+                sw_if_index=pg0.sw_if_index, checks=0x3FF
+            )
+        reply = self.vapi.cli("show interface features %s" % pg0.name)
+        self.assertIn("ip4-validate", reply)
+
+    def test_per_interface_drop_counters(self):
+        """Drops are counted per receiving interface and reason"""
+        pg0 = self.pg_interfaces[0]
+        pg1 = self.pg_interfaces[1]
+        name = "/ip-validate/src-loopback"
+
+        before = self.statistics.get_counter(name)
+        self.send_and_assert_dropped(
+            self.create_ipv4_packet(src_ip="127.0.0.1", dst_ip=None)
+        )
+        after = self.statistics.get_counter(name)
+
+        def total(counters, sw_if_index):
+            return sum(t[sw_if_index] for t in counters)
+
+        self.assertEqual(
+            total(after, pg0.sw_if_index) - total(before, pg0.sw_if_index), 1
+        )
+        self.assertEqual(
+            total(after, pg1.sw_if_index) - total(before, pg1.sw_if_index), 0
+        )
+
+    def test_profile_short_circuit(self):
+        """IPv4 frames that cannot fail their profile skip ip4-validate"""
+        pg0 = self.pg_interfaces[0]
+        frames = "/err/ip4-validate/frames short-circuited"
+
+        # dst-unspecified only: nothing an IPv4 packet can fail
+        self.vapi.ip_validate_set_profile(
+            sw_if_index=pg0.sw_if_index, checks=0x80
+        )
+        try:
+            before = self.statistics.get_err_counter(frames)
+            self.send_and_assert_forwarded(
+                self.create_ipv4_packet(src_ip="127.0.0.1", dst_ip=None)
+            )
+            self.assertEqual(self.statistics.get_err_counter(frames) - before, 1)
+
+            # the L2 check can fail on an Ethernet port like pg0
+            self.vapi.ip_validate_set_profile(
+                sw_if_index=pg0.sw_if_index, checks=0x1
+            )
+            before = self.statistics.get_err_counter(frames)
+            self.send_and_assert_dropped(
+                self.create_ipv4_packet(
+                    src_ip=pg0.remote_ip4, dst_ip=None,
+                    dst_mac="ff:ff:ff:ff:ff:ff",
+                ),
+                "/err/ip4-validate/unicast IP with multicast~broadcast "
+                "L2 destination",
+            )
+            self.assertEqual(self.statistics.get_err_counter(frames), before)
+        finally:
+            self.vapi.ip_validate_set_profile(
+                sw_if_index=pg0.sw_if_index, checks=0x3FF
+            )
+
+    # ================================================================
+    # Bogon sets
+    # ================================================================
+
+    def bogon_hits(self, set_id=0):
+        """{prefix: hits} of a bogon set."""
+        return {
+            str(d.prefix): d.hits
+            for d in self.vapi.ip_validate_bogon_dump(set_id=set_id)
+        }
+
+    def test_bogon_prefixes(self):
+        """Configured bogons drop per prefix, longest match first"""
+        pg0 = self.pg_interfaces[0]
+        pg1 = self.pg_interfaces[1]
+        counter = "/err/ip4-validate/source address is a configured bogon"
+
+        for prefix in ("198.51.100.0/24", "198.51.100.128/25"):
+            self.vapi.ip_validate_bogon_add_del(set_id=0, prefix=prefix)
+        try:
+            before = self.statistics.get_err_counter(counter)
+
+            # 11 packets so both the four-wide and the single lookups run
+            stream = [
+                self.create_ipv4_packet(src_ip="198.51.100.%d" % (i * 20 + 1),
+                                        dst_ip=None)
+                for i in range(11)
+            ]
+            stream += [self.create_ipv4_packet(src_ip="10.0.0.1", dst_ip=None)]
+            pg0.add_stream(stream)
+            pg1.enable_capture()
+            self.pg_start()
+
+            pg1.get_capture(1)
+            self.assertEqual(
+                self.statistics.get_err_counter(counter) - before, 11
+            )
+            # .1 .. .121 in the /24, .141 .. .201 in the /25
+            self.assertEqual(
+                self.bogon_hits(),
+                {"198.51.100.0/24": 7, "198.51.100.128/25": 4},
+            )
+
+            # without the /25 its addresses fall back to the /24
+            self.vapi.ip_validate_bogon_add_del(
+                is_add=False, set_id=0, prefix="198.51.100.128/25"
+            )
+            self.send_and_assert_dropped(
+                self.create_ipv4_packet(src_ip="198.51.100.200", dst_ip=None),
+                counter,
+            )
+            self.assertEqual(self.bogon_hits(), {"198.51.100.0/24": 8})
+        finally:
+            for d in self.vapi.ip_validate_bogon_dump(set_id=0):
+                self.vapi.ip_validate_bogon_add_del(
+                    is_add=False, set_id=0, prefix=d.prefix
+                )
+
+        self.send_and_assert_forwarded(
+            self.create_ipv4_packet(src_ip="198.51.100.1", dst_ip=None)
+        )
+
+    def test_bogon_set_per_interface(self):
+        """A bogon set applies to the interfaces bound to it"""
+        pg0 = self.pg_interfaces[0]
+        pkt = self.create_ipv4_packet(src_ip="203.0.113.9", dst_ip=None)
+
+        self.vapi.ip_validate_bogon_add_del(set_id=7, prefix="203.0.113.0/24")
+        try:
+            # pg0 is still bound to set 0
+            self.send_and_assert_forwarded(pkt)
+
+            self.vapi.ip_validate_bogon_set_bind(
+                sw_if_index=pg0.sw_if_index, set_id=7
+            )
+            details = self.vapi.ip_validate_profile_dump(
+                sw_if_index=pg0.sw_if_index
+            )
+            self.assertEqual(details[0].bogon_set_id, 7)
+            self.send_and_assert_dropped(pkt)
+
+            # and only while its profile has the src-bogon check
+            self.vapi.ip_validate_set_profile(
+                sw_if_index=pg0.sw_if_index, checks=0x1FF
+            )
+            self.send_and_assert_forwarded(pkt)
+        finally:
+            self.vapi.ip_validate_set_profile(
+                sw_if_index=pg0.sw_if_index, checks=0x3FF
+            )
+            self.vapi.ip_validate_bogon_set_bind(
+                sw_if_index=pg0.sw_if_index, set_id=0
+            )
+            self.vapi.ip_validate_bogon_add_del(
+                is_add=False, set_id=7, prefix="203.0.113.0/24"
+            )
+
     # ================================================================
     # Mixed batch tests (valid + invalid in one stream)
     # ================================================================
@@ -565,6 +772,42 @@ class TestIpValidate(VppTestCase):
             "Only the 5 valid packets should be forwarded",
         )
 
+    def test_mixed_batch_ipv4_counters(self):
+        """IPv4: per-reason counts over several 8-packet chunks"""
+        pg0 = self.pg_interfaces[0]
+        pg1 = self.pg_interfaces[1]
+
+        invalid = {
+            "source address is loopback": "127.0.0.1",
+            "source address is multicast": "224.1.1.1",
+            "source address is class E": "240.0.0.1",
+            "source address is unspecified": "0.0.0.0",
+            "source address is link-local": "169.254.1.1",
+        }
+        counters = ["/err/ip4-validate/%s" % r for r in invalid]
+        counters.append("/err/ip4-validate/valid packets")
+        before = {c: self.statistics.get_err_counter(c) for c in counters}
+
+        # 21 packets: two full chunks plus a remainder, one invalid
+        # packet in a different lane of each chunk
+        stream = [
+            self.create_ipv4_packet(src_ip="10.0.0.%d" % (i + 1), dst_ip=None)
+            for i in range(21)
+        ]
+        for lane, src_ip in zip((0, 7, 10, 15, 19), invalid.values()):
+            stream[lane] = self.create_ipv4_packet(src_ip=src_ip, dst_ip=None)
+
+        pg0.add_stream(stream)
+        pg1.enable_capture()
+        self.pg_start()
+
+        pg1.get_capture(16)
+        for c in counters:
+            expected = 16 if c.endswith("valid packets") else 1
+            self.assertEqual(
+                self.statistics.get_err_counter(c) - before[c], expected, c
+            )
+
     def test_mixed_batch_ipv6(self):
         """IPv6: mixed valid and invalid packets in one stream"""
         pg0 = self.pg_interfaces[0]
@@ -597,6 +840,110 @@ class TestIpValidate(VppTestCase):
             "Only the 5 valid packets should be forwarded",
         )
 
+    def test_mixed_batch_ipv6_counters(self):
+        """IPv6: per-reason counts over several 8-packet chunks"""
+        pg0 = self.pg_interfaces[0]
+        pg1 = self.pg_interfaces[1]
+
+        invalid = {
+            "source address is multicast": ("ff02::1", None),
+            "source address is unspecified": ("::", None),
+            "source address is loopback": ("::1", None),
+            "destination address is unspecified": ("2001:db8::99", "::"),
+            "destination address is loopback": ("2001:db8::99", "::1"),
+        }
+        counters = ["/err/ip6-validate/%s" % r for r in invalid]
+        counters.append("/err/ip6-validate/valid packets")
+        before = {c: self.statistics.get_err_counter(c) for c in counters}
+
+        # 21 packets: two full chunks plus a remainder, one invalid
+        # packet in a different lane of each chunk; ::2 and 100::1 are
+        # each one byte away from ::1 and must pass
+        stream = [
+            self.create_ipv6_packet(src_ip="2001:db8::%d" % (i + 1), dst_ip=None)
+            for i in range(21)
+        ]
+        stream[3] = self.create_ipv6_packet(src_ip="::2", dst_ip=None)
+        stream[12] = self.create_ipv6_packet(src_ip="100::1", dst_ip=None)
+        for lane, (src_ip, dst_ip) in zip((0, 7, 10, 15, 19), invalid.values()):
+            stream[lane] = self.create_ipv6_packet(src_ip=src_ip, dst_ip=dst_ip)
+
+        pg0.add_stream(stream)
+        pg1.enable_capture()
+        self.pg_start()
+
+        pg1.get_capture(16)
+        for c in counters:
+            expected = 16 if c.endswith("valid packets") else 1
+            self.assertEqual(
+                self.statistics.get_err_counter(c) - before[c], expected, c
+            )
+
+    # ================================================================
+    # Benchmark
+    # ================================================================
+
+    @unittest.skipUnless(config.extended, "part of extended tests")
+    def test_ip6_clocks_per_packet(self):
+        """ip6-validate clocks/packet on valid traffic, vs ip4-validate"""
+        pg0 = self.pg_interfaces[0]
+        results = {
+            node: bench_node(self, pg0, pkt, node)
+            for node, pkt in (
+                (
+                    "ip6-validate",
+                    self.create_ipv6_packet(pg0.remote_ip6, None),
+                ),
+                (
+                    "ip4-validate",
+                    self.create_ipv4_packet(pg0.remote_ip4, None),
+                ),
+            )
+        }
+
+        # Both run an eight-packet main loop, and ip6-validate classifies
+        # each address with one vector compare: a 16-byte address must
+        # not cost much more than a 4-byte one.
+        assert_clocks_within(self, results, "ip6-validate", "ip4-validate", 1.5)
+
+    @unittest.skipUnless(config.extended, "part of extended tests")
+    def test_ip4_short_circuit_clocks_per_packet(self):
+        """ip4-validate clocks/packet, short-circuited vs parsed frames"""
+        pg0 = self.pg_interfaces[0]
+        pkt = self.create_ipv4_packet(pg0.remote_ip4, None)
+        results = {}
+
+        try:
+            # Both profiles take the run-time-mask path and pass every
+            # packet; only dst-unspecified alone cannot fail on IPv4.
+            for name, checks in (("short-circuit", 0x80), ("parsed", 0x1)):
+                self.vapi.ip_validate_set_profile(
+                    sw_if_index=pg0.sw_if_index, checks=checks
+                )
+                results[name] = bench_node(self, pg0, pkt, "ip4-validate")
+        finally:
+            self.vapi.ip_validate_set_profile(
+                sw_if_index=pg0.sw_if_index, checks=0x3FF
+            )
+
+        # A vnet_feature_next per packet, no header reads
+        assert_clocks_within(self, results, "short-circuit", "parsed", 1.0)
+
+    # ================================================================
+    # Multiarch node variants
+    # ================================================================
+
+    def test_node_variants(self):
+        """ip4/ip6-validate are registered with per-CPU march variants"""
+        if platform.machine() != "x86_64":
+            self.skipTest("march variant names below are x86 specific")
+        for node in ("ip4-validate", "ip6-validate"):
+            reply = self.vapi.cli("show node %s" % node)
+            self.assertIn("node function variants", reply)
+            # hsw (AVX2) is built for every x86 MULTIARCH_SOURCES file
+            # whether or not the CPU running the test supports it.
+            self.assertIn("hsw", reply, "%s has no AVX2 variant" % node)
+
 
 if __name__ == "__main__":
     unittest.main(testRunner=VppTestRunner)
@@ -48,8 +48,8 @@
  * member tap, the feature-arc config of the aggregate tap no longer
  * applies: the next pass uses the member tap's per-interface
  * features, and since this redirect is only enabled on aggregate
- * taps (not member taps) there is no recursion.  The cleared magic
- * cookie is a second line of defence.
+ * taps (not member taps) there is no recursion.  The consumed
+ * (SONIC_EXT_BUFFER_MAGIC_DONE) cookie is a second line of defence.
  */
 
 typedef struct
@@ -158,7 +158,7 @@ VLIB_NODE_FN (sonic_ext_aggr_tap_redirect_node)
 	{
 	  /* This path continues to output, so consume the cookie even when
 	   * no useful redirect target exists. */
-	  seb->magic = 0;
+	  seb->magic = SONIC_EXT_BUFFER_MAGIC_DONE;
 	  n_no_lcp++;
 	  goto trace0;
 	}
@@ -166,6 +166,10 @@ VLIB_NODE_FN (sonic_ext_aggr_tap_redirect_node)
       next[0] = SONIC_EXT_AGGR_TAP_REDIRECT_NEXT_INTERFACE_OUTPUT;
       did_redirect = 1;
       n_redirected++;
+      sonic_ext_if_counter_add (vm, &sem->if_punt_redirects, orig_rx, 1);
+      if (PREDICT_FALSE (sem->latency_enabled))
+	sonic_ext_latency_record (vm, SONIC_EXT_LATENCY_EXIT_AGGR_TAP, seb,
+				  sonic_ext_latency_now ());
 
     trace0:
       if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE) &&
@@ -205,7 +209,8 @@ VLIB_NODE_FN (sonic_ext_aggr_tap_redirect_node)
 				 SONIC_EXT_AGGR_TAP_REDIRECT_ERROR_DISABLED,
 				 n_disabled);
 
-  sem->aggr_tap_redirects += n_redirected;
+  sonic_ext_counter_add (vm, SONIC_EXT_COUNTER_AGGR_TAP_REDIRECTS,
+			 n_redirected);
   return frame->n_vectors;
 }
 
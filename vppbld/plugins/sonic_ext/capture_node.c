@@ -65,14 +65,99 @@ static char *sonic_ext_capture_error_strings[] = {
 #undef _
 };
 
+/*
+ * Snapshot the outermost VLAN tag (if any) directly off the wire frame.
+ * At device-input the buffer's current_data is still positioned at the
+ * start of the ethernet header and no tag-rewrite has run yet, so bytes
+ * [12..16] are either the ethertype (untagged) or TPID+TCI (tagged).
+ * Storing the raw 4 bytes lets the aggr-tap redirect re-push them
+ * verbatim if the bridge later pops the tag.
+ */
+static_always_inline u32
+sonic_ext_capture_vlan_tag (u8 *p)
+{
+  u16 etype = clib_net_to_host_u16 (*(u16 *) (p + 12));
+
+  if (etype == ETHERNET_TYPE_VLAN /* 0x8100 */
+      || etype == ETHERNET_TYPE_DOT1AD /* 0x88a8 */
+      || etype == ETHERNET_TYPE_VLAN_9100 /* 0x9100 */)
+    return *(u32 *) (p + 12); /* TPID|TCI net order */
+  return 0;
+}
+
+/*
+ * Same as sonic_ext_capture_vlan_tag() for four frames.  The four
+ * TPID|TCI words sit in four different buffers, so no single vector
+ * load reaches them: each is read once, straight into its lane (the
+ * word is also the value stored).  The TPID halves are compared
+ * against all three TPIDs lane-wise, and the lane masks select the word
+ * or 0 with one AND and one vector store -- no per-packet compare,
+ * branch or second load.
+ */
+static_always_inline void
+sonic_ext_capture_vlan_tag_x4 (u8 *p0, u8 *p1, u8 *p2, u8 *p3, u32 *tags)
+{
+#ifdef CLIB_HAVE_VEC128
+  u32x4 w = { *(u32 *) (p0 + 12), *(u32 *) (p1 + 12), *(u32 *) (p2 + 12),
+	      *(u32 *) (p3 + 12) };
+  u32x4 dot1q = u32x4_splat (clib_host_to_net_u16 (ETHERNET_TYPE_VLAN));
+  u32x4 dot1ad = u32x4_splat (clib_host_to_net_u16 (ETHERNET_TYPE_DOT1AD));
+  u32x4 qinq = u32x4_splat (clib_host_to_net_u16 (ETHERNET_TYPE_VLAN_9100));
+  /* bytes 12-13, the TPID in network order, are the low half */
+  u32x4 tpid = w & u32x4_splat (0xffff);
+  u32x4 m;
+
+  m = (u32x4) ((tpid == dot1q) | (tpid == dot1ad) | (tpid == qinq));
+
+  u32x4_store_unaligned (w & m, tags);
+#else
+  tags[0] = sonic_ext_capture_vlan_tag (p0);
+  tags[1] = sonic_ext_capture_vlan_tag (p1);
+  tags[2] = sonic_ext_capture_vlan_tag (p2);
+  tags[3] = sonic_ext_capture_vlan_tag (p3);
+#endif
+}
+
+/*
+ * Stamp the per-buffer cookie.  orig_rx is read per buffer on purpose:
+ * a device-input feature frame is not guaranteed to hold a single
+ * interface (drivers only flag single-interface frames when the next
+ * node is ethernet-input), and sw_if_index[VLIB_RX] sits on the header
+ * cache line that vnet_feature_next() loads anyway.
+ */
+static_always_inline void
+sonic_ext_capture_one (vlib_buffer_t *b, u32 vlan_tag, u32 ts)
+{
+  sonic_ext_buffer_opaque_t *seb = sonic_ext_buffer (b);
+
+  seb->orig_rx_sw_if_index = vnet_buffer (b)->sw_if_index[VLIB_RX];
+  seb->orig_vlan_tag = vlan_tag;
+  seb->ingress_ts = ts;
+  seb->magic = SONIC_EXT_BUFFER_MAGIC;
+}
+
+static_always_inline void
+sonic_ext_capture_trace_one (vlib_main_t *vm, vlib_node_runtime_t *node,
+			     vlib_buffer_t *b)
+{
+  if (PREDICT_FALSE (b->flags & VLIB_BUFFER_IS_TRACED))
+    {
+      sonic_ext_capture_trace_t *t = vlib_add_trace (vm, node, b, sizeof (*t));
+      t->sw_if_index = vnet_buffer (b)->sw_if_index[VLIB_RX];
+    }
+}
+
 VLIB_NODE_FN (sonic_ext_capture_node)
 (vlib_main_t *vm, vlib_node_runtime_t *node, vlib_frame_t *frame)
 {
-  sonic_ext_main_t *sem = &sonic_ext_main;
   u32 n_left_from, *from;
   vlib_buffer_t *bufs[VLIB_FRAME_SIZE], **b;
   u16 nexts[VLIB_FRAME_SIZE], *next;
-  u32 n_captured = 0;
+  u32 ts;
+
+  /* One timestamp per frame: the whole frame came off the wire in the
+   * same driver poll, and it keeps rdtsc out of the per-packet path. */
+  ts = sonic_ext_main.latency_enabled ? sonic_ext_latency_now () : 0;
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
@@ -80,48 +165,68 @@ VLIB_NODE_FN (sonic_ext_capture_node)
   b = bufs;
   next = nexts;
 
-  while (n_left_from > 0)
+  while (n_left_from >= 4)
     {
-      u32 next0;
-      sonic_ext_buffer_opaque_t *seb;
+      u32 tags[4];
+
+      /* Two frames ahead: the header lines we read (feature config,
+       * sw_if_index) and write (opaque2).  One frame ahead: the
+       * ethernet header we snapshot the tag from. */
+      if (n_left_from >= 12)
+	{
+	  vlib_prefetch_buffer_header (b[8], LOAD);
+	  vlib_prefetch_buffer_header (b[9], LOAD);
+	  vlib_prefetch_buffer_header (b[10], LOAD);
+	  vlib_prefetch_buffer_header (b[11], LOAD);
+	  clib_prefetch_store (sonic_ext_buffer (b[8]));
+	  clib_prefetch_store (sonic_ext_buffer (b[9]));
+	  clib_prefetch_store (sonic_ext_buffer (b[10]));
+	  clib_prefetch_store (sonic_ext_buffer (b[11]));
+
+	  vlib_prefetch_buffer_data (b[4], LOAD);
+	  vlib_prefetch_buffer_data (b[5], LOAD);
+	  vlib_prefetch_buffer_data (b[6], LOAD);
+	  vlib_prefetch_buffer_data (b[7], LOAD);
+	}
 
       /* Feature-arc next: continue to ethernet-input or whatever runs
        * after us on the device-input arc. */
-      vnet_feature_next (&next0, b[0]);
-      next[0] = (u16) next0;
-
-      seb = sonic_ext_buffer (b[0]);
-      seb->orig_rx_sw_if_index = vnet_buffer (b[0])->sw_if_index[VLIB_RX];
-
-      /* Snapshot the outermost VLAN tag (if any) directly off the
-       * wire frame.  At device-input the buffer's current_data is
-       * still positioned at the start of the ethernet header and
-       * no tag-rewrite has run yet, so bytes [12..16] are either
-       * the ethertype (untagged) or TPID+TCI (tagged).  Storing
-       * the raw 4 bytes lets the aggr-tap redirect re-push them
-       * verbatim if the bridge later pops the tag. */
-      {
-	u8 *p = vlib_buffer_get_current (b[0]);
-	u16 etype = clib_net_to_host_u16 (*(u16 *) (p + 12));
-	if (etype == ETHERNET_TYPE_VLAN /* 0x8100 */
-	    || etype == ETHERNET_TYPE_DOT1AD /* 0x88a8 */
-	    || etype == ETHERNET_TYPE_VLAN_9100 /* 0x9100 */)
-	  seb->orig_vlan_tag = *(u32 *) (p + 12); /* TPID|TCI net order */
-	else
-	  seb->orig_vlan_tag = 0;
-      }
-
-      seb->magic = SONIC_EXT_BUFFER_MAGIC;
-      n_captured++;
-
-      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE) &&
-			 (b[0]->flags & VLIB_BUFFER_IS_TRACED)))
+      vnet_feature_next_u16 (&next[0], b[0]);
+      vnet_feature_next_u16 (&next[1], b[1]);
+      vnet_feature_next_u16 (&next[2], b[2]);
+      vnet_feature_next_u16 (&next[3], b[3]);
+
+      sonic_ext_capture_vlan_tag_x4 (
+	vlib_buffer_get_current (b[0]), vlib_buffer_get_current (b[1]),
+	vlib_buffer_get_current (b[2]), vlib_buffer_get_current (b[3]), tags);
+
+      sonic_ext_capture_one (b[0], tags[0], ts);
+      sonic_ext_capture_one (b[1], tags[1], ts);
+      sonic_ext_capture_one (b[2], tags[2], ts);
+      sonic_ext_capture_one (b[3], tags[3], ts);
+
+      if (PREDICT_FALSE (node->flags & VLIB_NODE_FLAG_TRACE))
 	{
-	  sonic_ext_capture_trace_t *t =
-	    vlib_add_trace (vm, node, b[0], sizeof (*t));
-	  t->sw_if_index = vnet_buffer (b[0])->sw_if_index[VLIB_RX];
+	  sonic_ext_capture_trace_one (vm, node, b[0]);
+	  sonic_ext_capture_trace_one (vm, node, b[1]);
+	  sonic_ext_capture_trace_one (vm, node, b[2]);
+	  sonic_ext_capture_trace_one (vm, node, b[3]);
 	}
 
+      b += 4;
+      next += 4;
+      n_left_from -= 4;
+    }
+
+  while (n_left_from > 0)
+    {
+      vnet_feature_next_u16 (&next[0], b[0]);
+      sonic_ext_capture_one (
+	b[0], sonic_ext_capture_vlan_tag (vlib_buffer_get_current (b[0])), ts);
+
+      if (PREDICT_FALSE (node->flags & VLIB_NODE_FLAG_TRACE))
+	sonic_ext_capture_trace_one (vm, node, b[0]);
+
       b += 1;
       next += 1;
       n_left_from -= 1;
@@ -129,10 +234,11 @@ VLIB_NODE_FN (sonic_ext_capture_node)
 
   vlib_buffer_enqueue_to_next (vm, node, from, nexts, frame->n_vectors);
 
-  if (n_captured)
-    vlib_node_increment_counter (vm, sonic_ext_capture_node.index,
-				 SONIC_EXT_CAPTURE_ERROR_CAPTURED, n_captured);
-  sem->captures += n_captured;
+  /* Every buffer is stamped; there is no pass-through case. */
+  vlib_node_increment_counter (vm, sonic_ext_capture_node.index,
+			       SONIC_EXT_CAPTURE_ERROR_CAPTURED,
+			       frame->n_vectors);
+  sonic_ext_counter_add (vm, SONIC_EXT_COUNTER_CAPTURES, frame->n_vectors);
 
   return frame->n_vectors;
 }
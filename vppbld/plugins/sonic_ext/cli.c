@@ -49,6 +49,7 @@ VLIB_CLI_COMMAND (sonic_ext_punt_via_member_command, static) = {
   .path = "sonic-ext punt-via-member",
   .short_help = "sonic-ext punt-via-member [on|enable|off|disable]",
   .function = sonic_ext_punt_via_member_command_fn,
+  .is_mp_safe = 1,
 };
 
 static clib_error_t *
@@ -61,7 +62,13 @@ sonic_ext_host_xc_command_fn (vlib_main_t *vm, unformat_input_t *input,
 
   while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
     {
-      if (unformat (line_input, "on") || unformat (line_input, "enable"))
+      if (unformat (line_input, "direct-tx on") ||
+	  unformat (line_input, "direct-tx enable"))
+	sonic_ext_set_host_xc_direct_tx (1);
+      else if (unformat (line_input, "direct-tx off") ||
+	       unformat (line_input, "direct-tx disable"))
+	sonic_ext_set_host_xc_direct_tx (0);
+      else if (unformat (line_input, "on") || unformat (line_input, "enable"))
 	sonic_ext_set_host_xc (1);
       else if (unformat (line_input, "off") ||
 	       unformat (line_input, "disable"))
@@ -80,8 +87,159 @@ sonic_ext_host_xc_command_fn (vlib_main_t *vm, unformat_input_t *input,
 
 VLIB_CLI_COMMAND (sonic_ext_host_xc_command, static) = {
   .path = "sonic-ext host-xc",
-  .short_help = "sonic-ext host-xc [on|enable|off|disable]",
+  .short_help = "sonic-ext host-xc [on|enable|off|disable] "
+		"[direct-tx <on|enable|off|disable>]",
   .function = sonic_ext_host_xc_command_fn,
+  .is_mp_safe = 1,
+};
+
+static clib_error_t *
+sonic_ext_capture_command_fn (vlib_main_t *vm, unformat_input_t *input,
+			      vlib_cli_command_t *cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return 0;
+
+  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (line_input, "all"))
+	sonic_ext_set_capture_on_demand (0);
+      else if (unformat (line_input, "on-demand"))
+	sonic_ext_set_capture_on_demand (1);
+      else
+	{
+	  unformat_free (line_input);
+	  return clib_error_return (0, "unknown input `%U'",
+				    format_unformat_error, line_input);
+	}
+    }
+
+  unformat_free (line_input);
+  return 0;
+}
+
+VLIB_CLI_COMMAND (sonic_ext_capture_command, static) = {
+  .path = "sonic-ext capture",
+  .short_help = "sonic-ext capture [all|on-demand]",
+  .function = sonic_ext_capture_command_fn,
+};
+
+/* Interface names are resolved one by one, so that an unknown one only
+ * fails its own pair (with ~0, i.e. INVALID_SW_IF_INDEX). */
+static u32
+sonic_ext_lcp_cli_phy (vnet_main_t *vnm, u8 *name)
+{
+  unformat_input_t in;
+  u32 sw_if_index = ~0;
+
+  unformat_init_string (&in, (char *) name, vec_len (name));
+  if (!unformat (&in, "%U", unformat_vnet_sw_interface, vnm, &sw_if_index) ||
+      unformat_check_input (&in) != UNFORMAT_END_OF_INPUT)
+    sw_if_index = ~0;
+  unformat_free (&in);
+  return sw_if_index;
+}
+
+static clib_error_t *
+sonic_ext_lcp_command_fn (vlib_main_t *vm, unformat_input_t *input,
+			  vlib_cli_command_t *cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  vnet_main_t *vnm = vnet_get_main ();
+  sonic_ext_lcp_pair_req_t *reqs = 0;
+  sonic_ext_lcp_pair_req_t r = {};
+  clib_error_t *error = 0;
+  u8 **names = 0, *name = 0;
+  int is_add = -1;
+  u32 flags = 0, i;
+
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return 0;
+
+  if (unformat (line_input, "create"))
+    is_add = 1;
+  else if (unformat (line_input, "delete"))
+    is_add = 0;
+
+  while (is_add >= 0 &&
+	 unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (is_add && unformat (line_input, "gso"))
+	flags |= SONIC_EXT_LCP_F_GSO;
+      else if (is_add && unformat (line_input, "gro"))
+	flags |= SONIC_EXT_LCP_F_GSO | SONIC_EXT_LCP_F_GRO;
+      else if (is_add &&
+	       unformat (line_input, "%s host-if %s", &name, &r.host_if_name))
+	{
+	  vec_add1 (r.host_if_name, 0);
+	  r.phy_sw_if_index = sonic_ext_lcp_cli_phy (vnm, name);
+	  vec_add1 (reqs, r);
+	  vec_add1 (names, name);
+	  r.host_if_name = 0;
+	  name = 0;
+	}
+      else if (!is_add && unformat (line_input, "%s", &name))
+	{
+	  r.phy_sw_if_index = sonic_ext_lcp_cli_phy (vnm, name);
+	  vec_add1 (reqs, r);
+	  vec_add1 (names, name);
+	  name = 0;
+	}
+      else
+	{
+	  error = clib_error_return (0, "unknown input `%U'",
+				     format_unformat_error, line_input);
+	  goto done;
+	}
+    }
+
+  if (is_add < 0 || vec_len (reqs) == 0)
+    {
+      error = clib_error_return (0, "please specify create|delete and at "
+				    "least one interface");
+      goto done;
+    }
+
+  sonic_ext_lcp_pairs_add_del (reqs, is_add, flags);
+
+  /* One line per pair, in request order, whatever happened to the
+   * others. */
+  for (i = 0; i < vec_len (reqs); i++)
+    {
+      sonic_ext_lcp_pair_req_t *req = vec_elt_at_index (reqs, i);
+
+      if (req->phy_sw_if_index == ~0)
+	vlib_cli_output (vm, "%v: unknown interface", names[i]);
+      else if (req->rv)
+	vlib_cli_output (vm, "%v: %U", names[i], format_vnet_api_errno,
+			 req->rv);
+      else if (is_add)
+	vlib_cli_output (vm, "%v: created %U", names[i],
+			 format_vnet_sw_if_index_name, vnm,
+			 req->host_sw_if_index);
+      else
+	vlib_cli_output (vm, "%v: deleted", names[i]);
+    }
+
+done:
+  for (i = 0; i < vec_len (reqs); i++)
+    vec_free (reqs[i].host_if_name);
+  vec_free (reqs);
+  for (i = 0; i < vec_len (names); i++)
+    vec_free (names[i]);
+  vec_free (names);
+  vec_free (name);
+  vec_free (r.host_if_name);
+  unformat_free (line_input);
+  return error;
+}
+
+VLIB_CLI_COMMAND (sonic_ext_lcp_command, static) = {
+  .path = "sonic-ext lcp",
+  .short_help = "sonic-ext lcp create [gso] [gro] <phy> host-if <name> "
+		"[<phy> host-if <name> ...] | delete <phy> [<phy> ...]",
+  .function = sonic_ext_lcp_command_fn,
 };
 
 static clib_error_t *
@@ -147,6 +305,320 @@ VLIB_CLI_COMMAND (sonic_ext_ip2me_command, static) = {
   .function = sonic_ext_ip2me_command_fn,
 };
 
+static clib_error_t *
+sonic_ext_copp_command_fn (vlib_main_t *vm, unformat_input_t *input,
+			   vlib_cli_command_t *cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  sonic_ext_copp_class_t c;
+  u32 rate, burst;
+  clib_error_t *error = 0;
+
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return 0;
+
+  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (line_input, "on") || unformat (line_input, "enable"))
+	sonic_ext_set_copp (1);
+      else if (unformat (line_input, "off") ||
+	       unformat (line_input, "disable"))
+	sonic_ext_set_copp (0);
+      else if (unformat (line_input, "class %U rate %u",
+			 unformat_sonic_ext_copp_class, &c, &rate))
+	{
+	  burst = 0;
+	  if (unformat (line_input, "burst %u", &burst))
+	    ;
+	  sonic_ext_copp_set_class (c, rate, burst);
+	}
+      else
+	{
+	  error = clib_error_return (0, "unknown input `%U'",
+				     format_unformat_error, line_input);
+	  break;
+	}
+    }
+
+  unformat_free (line_input);
+  return error;
+}
+
+VLIB_CLI_COMMAND (sonic_ext_copp_command, static) = {
+  .path = "sonic-ext copp",
+  .short_help = "sonic-ext copp [on|enable|off|disable] "
+		"[class <name> rate <pps> [burst <pkts>]]",
+  .function = sonic_ext_copp_command_fn,
+};
+
+static clib_error_t *
+show_sonic_ext_copp_command_fn (vlib_main_t *vm, unformat_input_t *input,
+				vlib_cli_command_t *cmd)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  sonic_ext_copp_class_cfg_t *cfg;
+  u32 i;
+
+  vlib_cli_output (vm, "sonic-ext copp: %s",
+		   sem->copp_enabled ? "on" : "off");
+  vlib_cli_output (vm, "  %-12s %10s %10s %14s %14s", "class", "rate",
+		   "burst", "passed", "dropped");
+  for (i = 0; i < SONIC_EXT_COPP_N_CLASSES; i++)
+    {
+      cfg = &sem->copp_classes[i];
+      if (cfg->rate_pps)
+	vlib_cli_output (vm, "  %-12U %10u %10u %14llu %14llu",
+			 format_sonic_ext_copp_class, i, cfg->rate_pps,
+			 cfg->burst,
+			 vlib_get_simple_counter (&sem->copp_passed, i),
+			 vlib_get_simple_counter (&sem->copp_dropped, i));
+      else
+	vlib_cli_output (vm, "  %-12U %10s %10s %14llu %14llu",
+			 format_sonic_ext_copp_class, i, "-", "-",
+			 vlib_get_simple_counter (&sem->copp_passed, i),
+			 vlib_get_simple_counter (&sem->copp_dropped, i));
+    }
+  return 0;
+}
+
+VLIB_CLI_COMMAND (show_sonic_ext_copp_command, static) = {
+  .path = "show sonic-ext copp",
+  .short_help = "show sonic-ext copp",
+  .function = show_sonic_ext_copp_command_fn,
+};
+
+static clib_error_t *
+sonic_ext_punt_queue_command_fn (vlib_main_t *vm, unformat_input_t *input,
+				 vlib_cli_command_t *cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  sonic_ext_copp_class_t c;
+  u32 queue, prio, frame_limit;
+  clib_error_t *error = 0;
+
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return 0;
+
+  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (line_input, "on") || unformat (line_input, "enable"))
+	sonic_ext_set_punt_prio (1);
+      else if (unformat (line_input, "off") ||
+	       unformat (line_input, "disable"))
+	sonic_ext_set_punt_prio (0);
+      else if (unformat (line_input, "class %U queue %u priority %u",
+			 unformat_sonic_ext_copp_class, &c, &queue, &prio))
+	{
+	  frame_limit = 0;
+	  if (unformat (line_input, "frame-limit %u", &frame_limit))
+	    ;
+	  if (sonic_ext_punt_queue_set_class (c, queue, prio, frame_limit))
+	    {
+	      error = clib_error_return (0, "priority must be 0..%u",
+					 SONIC_EXT_PUNT_N_PRIOS - 1);
+	      break;
+	    }
+	}
+      else
+	{
+	  error = clib_error_return (0, "unknown input `%U'",
+				     format_unformat_error, line_input);
+	  break;
+	}
+    }
+
+  unformat_free (line_input);
+  return error;
+}
+
+VLIB_CLI_COMMAND (sonic_ext_punt_queue_command, static) = {
+  .path = "sonic-ext punt-queue",
+  .short_help = "sonic-ext punt-queue [on|enable|off|disable] "
+		"[class <name> queue <n> priority <0-3> [frame-limit <pkts>]]",
+  .function = sonic_ext_punt_queue_command_fn,
+};
+
+static clib_error_t *
+show_sonic_ext_punt_queue_command_fn (vlib_main_t *vm,
+				      unformat_input_t *input,
+				      vlib_cli_command_t *cmd)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  sonic_ext_punt_queue_cfg_t *qc;
+  u32 i;
+
+  vlib_cli_output (vm, "sonic-ext punt-queue: %s",
+		   sem->punt_prio ? "on" : "off");
+  vlib_cli_output (vm, "  %-12s %5s %4s %11s %14s %14s", "class", "queue",
+		   "prio", "frame-limit", "steered", "limit-drops");
+  for (i = 0; i < SONIC_EXT_COPP_N_CLASSES; i++)
+    {
+      qc = &sem->punt_queues[i];
+      vlib_cli_output (
+	vm, "  %-12U %5u %4u %11u %14llu %14llu", format_sonic_ext_copp_class,
+	i, qc->queue, qc->priority, qc->frame_limit,
+	vlib_get_simple_counter (&sem->punt_queue_steered, i),
+	vlib_get_simple_counter (&sem->punt_queue_limit_drops, i));
+    }
+  return 0;
+}
+
+VLIB_CLI_COMMAND (show_sonic_ext_punt_queue_command, static) = {
+  .path = "show sonic-ext punt-queue",
+  .short_help = "show sonic-ext punt-queue",
+  .function = show_sonic_ext_punt_queue_command_fn,
+};
+
+static clib_error_t *
+sonic_ext_punt_latency_command_fn (vlib_main_t *vm, unformat_input_t *input,
+				   vlib_cli_command_t *cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return 0;
+
+  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (line_input, "on") || unformat (line_input, "enable"))
+	sonic_ext_set_punt_latency (1);
+      else if (unformat (line_input, "off") ||
+	       unformat (line_input, "disable"))
+	sonic_ext_set_punt_latency (0);
+      else if (unformat (line_input, "clear"))
+	sonic_ext_punt_latency_clear ();
+      else
+	{
+	  unformat_free (line_input);
+	  return clib_error_return (0, "unknown input `%U'",
+				    format_unformat_error, line_input);
+	}
+    }
+
+  unformat_free (line_input);
+  return 0;
+}
+
+VLIB_CLI_COMMAND (sonic_ext_punt_latency_command, static) = {
+  .path = "sonic-ext punt-latency",
+  .short_help = "sonic-ext punt-latency [on|enable|off|disable|clear]",
+  .function = sonic_ext_punt_latency_command_fn,
+};
+
+static clib_error_t *
+show_sonic_ext_punt_latency_command_fn (vlib_main_t *vm,
+					unformat_input_t *input,
+					vlib_cli_command_t *cmd)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  f64 ns_per_clock = 1e9 * vm->clib_time.seconds_per_clock;
+  u32 e, i;
+  u64 n;
+
+  vlib_cli_output (vm, "sonic-ext punt-latency: %s",
+		   sem->latency_enabled ? "on" : "off");
+  for (e = 0; e < SONIC_EXT_LATENCY_N_EXITS; e++)
+    {
+      vlib_cli_output (vm, "  %s:", sem->latency[e].name);
+      for (i = 0; i < SONIC_EXT_LATENCY_N_BINS; i++)
+	{
+	  n = vlib_get_simple_counter (&sem->latency[e], i);
+	  if (n)
+	    vlib_cli_output (vm, "    %12.0f - %12.0f ns: %llu",
+			     (f64) (1ULL << i) * ns_per_clock,
+			     (f64) (2ULL << i) * ns_per_clock, n);
+	}
+    }
+  return 0;
+}
+
+VLIB_CLI_COMMAND (show_sonic_ext_punt_latency_command, static) = {
+  .path = "show sonic-ext punt-latency",
+  .short_help = "show sonic-ext punt-latency",
+  .function = show_sonic_ext_punt_latency_command_fn,
+};
+
+static clib_error_t *
+sonic_ext_glean_command_fn (vlib_main_t *vm, unformat_input_t *input,
+			    vlib_cli_command_t *cmd)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  unformat_input_t _line_input, *line_input = &_line_input;
+  u32 window = (u32) (sem->glean_window * 1e6 + 0.5);
+  u32 if_rate = sem->glean_if_rate;
+  u32 global_rate = sem->glean_global_rate;
+  clib_error_t *error = 0;
+
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return 0;
+
+  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (line_input, "window %u", &window))
+	;
+      else if (unformat (line_input, "port-rate %u", &if_rate))
+	;
+      else if (unformat (line_input, "global-rate %u", &global_rate))
+	;
+      else
+	{
+	  error = clib_error_return (0, "unknown input `%U'",
+				     format_unformat_error, line_input);
+	  goto done;
+	}
+    }
+
+  if (sonic_ext_set_glean_limits (window, if_rate, global_rate))
+    error = clib_error_return (0, "window must be non-zero");
+
+done:
+  unformat_free (line_input);
+  return error;
+}
+
+VLIB_CLI_COMMAND (sonic_ext_glean_command, static) = {
+  .path = "sonic-ext glean",
+  .short_help = "sonic-ext glean [window <usec>] [port-rate <pps>] "
+		"[global-rate <pps>]",
+  .function = sonic_ext_glean_command_fn,
+};
+
+static clib_error_t *
+show_sonic_ext_glean_command_fn (vlib_main_t *vm, unformat_input_t *input,
+				 vlib_cli_command_t *cmd)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  vnet_main_t *vnm = vnet_get_main ();
+  u32 i, n = vlib_simple_counter_n_counters (&sem->if_glean_throttled);
+  u64 v;
+
+  vlib_cli_output (vm, "sonic-ext glean: window %.0fus",
+		   sem->glean_window * 1e6);
+  if (sem->glean_if_rate)
+    vlib_cli_output (vm, "  port budget:   %u pps", sem->glean_if_rate);
+  else
+    vlib_cli_output (vm, "  port budget:   unlimited");
+  if (sem->glean_global_rate)
+    vlib_cli_output (vm, "  global budget: %u pps", sem->glean_global_rate);
+  else
+    vlib_cli_output (vm, "  global budget: unlimited");
+
+  vlib_cli_output (vm, "  throttled, by ingress port:");
+  for (i = 0; i < n; i++)
+    {
+      v = vlib_get_simple_counter (&sem->if_glean_throttled, i);
+      if (v && vnet_sw_interface_is_valid (vnm, i))
+	vlib_cli_output (vm, "    %-32U %14llu", format_vnet_sw_if_index_name,
+			 vnm, i, v);
+    }
+  return 0;
+}
+
+VLIB_CLI_COMMAND (show_sonic_ext_glean_command, static) = {
+  .path = "show sonic-ext glean",
+  .short_help = "show sonic-ext glean",
+  .function = show_sonic_ext_glean_command_fn,
+};
+
 static clib_error_t *
 show_sonic_ext_command_fn (vlib_main_t *vm, unformat_input_t *input,
 			   vlib_cli_command_t *cmd)
@@ -157,12 +629,19 @@ show_sonic_ext_command_fn (vlib_main_t *vm, unformat_input_t *input,
 		   sem->punt_via_member ? "on" : "off");
   vlib_cli_output (vm, "  host-xc         : %s",
 		   sem->host_xc ? "on" : "off");
-  vlib_cli_output (vm, "  captures        : %llu", sem->captures);
-  vlib_cli_output (vm, "  aggr-tap redir  : %llu", sem->aggr_tap_redirects);
-  vlib_cli_output (vm, "  glean redirect  : %llu", sem->glean_redirects);
-  vlib_cli_output (vm, "  host-xc direct  : %llu", sem->host_xc_direct);
-  vlib_cli_output (vm, "  l2 trap fixups  : %llu", sem->l2_trap_fixups);
-  vlib_cli_output (vm, "  ip2me hits      : %llu", sem->ip2me_hits);
+  vlib_cli_output (vm, "  host-xc tx      : %s",
+		   sem->host_xc_direct_tx ? "direct" : "interface-output");
+  vlib_cli_output (vm, "  capture         : %s (%u ports)",
+		   sem->capture_on_demand ? "on-demand" : "all",
+		   clib_bitmap_count_set_bits (sem->capture_sw_if_indexes));
+  vlib_cli_output (vm, "  ip2me addresses : %u ip4, %u ip6",
+		   sem->ip2me_n_local4, sem->ip2me_n_local6);
+#define _(sym, str)                                                           \
+  vlib_cli_output (vm, "  %-16s: %llu", str,                                 \
+		   vlib_get_simple_counter (&sem->counters,                  \
+					    SONIC_EXT_COUNTER_##sym));
+  foreach_sonic_ext_counter
+#undef _
   return 0;
 }
 
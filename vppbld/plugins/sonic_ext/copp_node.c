@@ -0,0 +1,565 @@
+/*
+ * Copyright (c) 2026 SONiC-VPP contributors
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <sonic_ext/sonic_ext.h>
+
+#include <vlib/vlib.h>
+#include <vnet/vnet.h>
+#include <vnet/feature/feature.h>
+#include <vnet/ip/ip4_packet.h>
+#include <vnet/ip/ip6_packet.h>
+#include <vnet/ip/icmp46_packet.h>
+#include <vnet/udp/udp_packet.h>
+#include <vnet/tcp/tcp_packet.h>
+
+/*
+ * sonic-ext-copp
+ *
+ * Feature on the `interface-output` arc, enabled per sw_if_index on
+ * every LCP host tap while CoPP is on.  Everything VPP hands to the
+ * kernel -- linux-cp-punt-xc, ip4/ip6 punt, ARP, and our own
+ * aggr-tap / glean redirects -- leaves through interface-output on a
+ * host tap, so this is the one place that sees the whole punt path.
+ *
+ * Each packet is classified into a trap class (ARP, ND, BGP, LACP,
+ * LLDP, DHCP, TTL-expiry, IP2ME, other) from its L2/L3/L4 headers and
+ * charged against that class's token bucket; when the bucket is empty
+ * the packet is dropped here instead of queueing behind a flood on the
+ * virtio tap.  A class with rate 0 is not policed.
+ *
+ * Runs after sonic-ext-aggr-tap-redirect: a packet redirected from an
+ * aggregate tap re-enters interface-output on the member tap and is
+ * policed there, exactly once.
+ *
+ * With priority punt on ("sonic-ext punt-queue on") the node also does
+ * the tap's TX queue selection itself, see sonic_ext_punt_steer.  The
+ * steered packets go straight to the tap's device TX node (not back to
+ * <tap>-output, which would run this arc again and pick its own queue),
+ * so any interface-output feature ordered after this one is skipped for
+ * them.
+ *
+ * It is also the tap-tx exit of the punt latency histograms: with
+ * "sonic-ext punt-latency on" every captured packet that reaches a host
+ * tap without having been redirected records its capture -> tap
+ * latency here (policed ones included: they made it through VPP, the
+ * policer is the kernel's protection).  Redirected packets were
+ * sampled at their redirect.  Every packet's cookie is cleared here,
+ * live or consumed, so that a recycled buffer cannot carry it on.
+ */
+
+typedef struct
+{
+  u32 sw_if_index;
+  u8 class;
+  u8 dropped;
+} sonic_ext_copp_trace_t;
+
+static u8 *
+format_sonic_ext_copp_trace (u8 *s, va_list *args)
+{
+  CLIB_UNUSED (vlib_main_t * vm) = va_arg (*args, vlib_main_t *);
+  CLIB_UNUSED (vlib_node_t * node) = va_arg (*args, vlib_node_t *);
+  sonic_ext_copp_trace_t *t = va_arg (*args, sonic_ext_copp_trace_t *);
+
+  s = format (s, "SONIC-EXT-COPP: tap %u class %U %s", t->sw_if_index,
+	      format_sonic_ext_copp_class, t->class,
+	      t->dropped ? "DROPPED" : "passed");
+  return s;
+}
+
+#define foreach_sonic_ext_copp_error                                          \
+  _ (PASSED, "punted packets within the trap rate")                           \
+  _ (POLICED, "punted packets dropped by the trap policer")                   \
+  _ (FRAME_LIMIT, "punted packets over their class frame limit")
+
+typedef enum
+{
+#define _(sym, str) SONIC_EXT_COPP_ERROR_##sym,
+  foreach_sonic_ext_copp_error
+#undef _
+    SONIC_EXT_COPP_N_ERROR,
+} sonic_ext_copp_error_t;
+
+static char *sonic_ext_copp_error_strings[] = {
+#define _(sym, string) string,
+  foreach_sonic_ext_copp_error
+#undef _
+};
+
+typedef enum
+{
+  SONIC_EXT_COPP_NEXT_DROP,
+  SONIC_EXT_COPP_N_NEXT,
+} sonic_ext_copp_next_t;
+
+static_always_inline sonic_ext_copp_class_t
+sonic_ext_copp_classify_ip4 (ip4_header_t *ip, i32 len)
+{
+  u8 *l4;
+
+  if (len < (i32) sizeof (*ip) || len < ip4_header_bytes (ip))
+    return SONIC_EXT_COPP_CLASS_IP2ME;
+  l4 = (u8 *) ip + ip4_header_bytes (ip);
+  len -= ip4_header_bytes (ip);
+
+  /* Non-first fragments carry no L4 header. */
+  if (ip4_get_fragment_offset (ip) == 0 && len >= 4)
+    {
+      udp_header_t *udp = (udp_header_t *) l4;
+
+      /* TTL expiry is not told by the header TTL: single-hop eBGP,
+       * OSPF, VRRP and the like are legitimately punted with TTL 1.
+       * VPP answers transit packets that expire here itself
+       * (ip4-icmp-error), so what the host actually gets for TTL
+       * expiry is the time-exceeded errors addressed to it. */
+      if (ip->protocol == IP_PROTOCOL_ICMP &&
+	  ((icmp46_header_t *) l4)->type == ICMP4_time_exceeded)
+	return SONIC_EXT_COPP_CLASS_TTL_EXPIRY;
+      if (ip->protocol == IP_PROTOCOL_UDP &&
+	  (udp->dst_port == clib_host_to_net_u16 (67) ||
+	   udp->dst_port == clib_host_to_net_u16 (68)))
+	return SONIC_EXT_COPP_CLASS_DHCP;
+      if (ip->protocol == IP_PROTOCOL_TCP &&
+	  (udp->dst_port == clib_host_to_net_u16 (179) ||
+	   udp->src_port == clib_host_to_net_u16 (179)))
+	return SONIC_EXT_COPP_CLASS_BGP;
+    }
+
+  return SONIC_EXT_COPP_CLASS_IP2ME;
+}
+
+static_always_inline sonic_ext_copp_class_t
+sonic_ext_copp_classify_ip6 (ip6_header_t *ip, i32 len)
+{
+  u8 *l4 = (u8 *) (ip + 1);
+
+  if (len < (i32) sizeof (*ip))
+    return SONIC_EXT_COPP_CLASS_IP2ME;
+  len -= sizeof (*ip);
+
+  /* Extension headers are not walked; anything behind one is IP2ME. */
+  if (len >= 4)
+    {
+      udp_header_t *udp = (udp_header_t *) l4;
+
+      if (ip->protocol == IP_PROTOCOL_ICMP6)
+	{
+	  icmp46_header_t *icmp = (icmp46_header_t *) l4;
+	  if (icmp->type >= ICMP6_router_solicitation &&
+	      icmp->type <= ICMP6_redirect)
+	    return SONIC_EXT_COPP_CLASS_ND;
+	  /* As for IPv4: by punt, not by hop limit. */
+	  if (icmp->type == ICMP6_time_exceeded)
+	    return SONIC_EXT_COPP_CLASS_TTL_EXPIRY;
+	}
+      else if (ip->protocol == IP_PROTOCOL_UDP &&
+	       (udp->dst_port == clib_host_to_net_u16 (546) ||
+		udp->dst_port == clib_host_to_net_u16 (547)))
+	return SONIC_EXT_COPP_CLASS_DHCP;
+      else if (ip->protocol == IP_PROTOCOL_TCP &&
+	       (udp->dst_port == clib_host_to_net_u16 (179) ||
+		udp->src_port == clib_host_to_net_u16 (179)))
+	return SONIC_EXT_COPP_CLASS_BGP;
+    }
+
+  return SONIC_EXT_COPP_CLASS_IP2ME;
+}
+
+/* Packets on the host tap TX path start at the Ethernet header. */
+static_always_inline sonic_ext_copp_class_t
+sonic_ext_copp_classify (vlib_buffer_t *b)
+{
+  u8 *p = vlib_buffer_get_current (b);
+  i32 len = b->current_length;
+  i32 off = 12;
+  u16 type;
+  int i;
+
+  if (len < 14)
+    return SONIC_EXT_COPP_CLASS_OTHER;
+  type = clib_net_to_host_u16 (*(u16 *) (p + off));
+
+  for (i = 0; i < 2 && (type == ETHERNET_TYPE_VLAN ||
+			type == ETHERNET_TYPE_DOT1AD ||
+			type == ETHERNET_TYPE_VLAN_9100);
+       i++)
+    {
+      off += 4;
+      if (len < off + 2)
+	return SONIC_EXT_COPP_CLASS_OTHER;
+      type = clib_net_to_host_u16 (*(u16 *) (p + off));
+    }
+  off += 2;
+
+  switch (type)
+    {
+    case ETHERNET_TYPE_ARP:
+      return SONIC_EXT_COPP_CLASS_ARP;
+    case ETHERNET_TYPE_SLOW_PROTOCOLS:
+      return SONIC_EXT_COPP_CLASS_LACP;
+    case ETHERNET_TYPE_LLDP:
+      return SONIC_EXT_COPP_CLASS_LLDP;
+    case ETHERNET_TYPE_IP4:
+      return sonic_ext_copp_classify_ip4 ((ip4_header_t *) (p + off),
+					  len - off);
+    case ETHERNET_TYPE_IP6:
+      return sonic_ext_copp_classify_ip6 ((ip6_header_t *) (p + off),
+					  len - off);
+    default:
+      return SONIC_EXT_COPP_CLASS_OTHER;
+    }
+}
+
+/*
+ * Token bucket in packets, one per class and shared by all threads so
+ * that a flood landing on a single worker still gets the full class
+ * rate.  The bucket is one word, the time it is full again
+ * (full_at): the tokens at `now` are (now + burst / rate - full_at) *
+ * rate, capped at burst, and taking k of them moves full_at k / rate
+ * later.  So taking and refilling is one compare-and-swap, with no
+ * lock for a worker to spin on or be preempted holding.  A frame takes
+ * what it needs of each class in one go, so the bucket's cache line
+ * moves at most once per class present in the frame, not per packet.
+ * Returns how many of the n packets may pass.
+ */
+static_always_inline u32
+sonic_ext_copp_police (sonic_ext_copp_bucket_t *bk,
+		       const sonic_ext_copp_class_cfg_t *cfg, u32 n, f64 now)
+{
+  u64 now_ns, depth_ns, full_at, old, new;
+  f64 per_pkt_ns;
+  u32 n_pass;
+
+  if (cfg->rate_pps == 0)
+    return n;
+
+  per_pkt_ns = 1e9 / cfg->rate_pps;
+  depth_ns = cfg->burst * per_pkt_ns;
+  now_ns = now * 1e9;
+
+  old = clib_atomic_load_relax_n (&bk->full_at);
+  do
+    {
+      /* A bucket full before now holds just burst. */
+      full_at = clib_max (old, now_ns);
+      /* Thread clocks are not in lockstep: another worker may have
+       * taken tokens from a slightly later "now" than ours. */
+      if (full_at >= now_ns + depth_ns)
+	return 0;
+      n_pass = clib_min (n, (u32) ((now_ns + depth_ns - full_at) /
+				   per_pkt_ns));
+      if (n_pass == 0)
+	return 0;
+      new = full_at + (u64) (n_pass * per_pkt_ns);
+    }
+  while (!clib_atomic_cmp_and_swap_acq_relax_n (&bk->full_at, &old, new,
+						 1 /* weak */));
+
+  return n_pass;
+}
+
+/*
+ * Priority punt: where a passed packet's host tap has several TX
+ * queues, it is not handed on down the arc but steered to its class's
+ * queue (see sonic_ext_punt_queue_cfg_t).  The steered packets are
+ * submitted class by class in strict priority order, so within a frame
+ * the tap ring slots go to LACP / BGP first, and each class may only
+ * submit `frame_limit` packets of a frame -- the rest are dropped here.
+ * There is no queue in front of the tap: priority holds within one
+ * frame only, and nothing is held back for the next.
+ */
+typedef struct
+{
+  vlib_frame_t *f;
+  u32 *to;
+  u32 next_index;
+  u16 queue_id;
+} sonic_ext_punt_tx_t;
+
+static_always_inline void
+sonic_ext_punt_tx_flush (vlib_main_t *vm, vlib_node_runtime_t *node,
+			 sonic_ext_punt_tx_t *tx)
+{
+  if (tx->f)
+    vlib_put_next_frame (vm, node, tx->next_index,
+			 VLIB_FRAME_SIZE -
+			   (tx->to - (u32 *) vlib_frame_vector_args (tx->f)));
+  tx->f = 0;
+}
+
+static_always_inline void
+sonic_ext_punt_tx_one (vlib_main_t *vm, vlib_node_runtime_t *node,
+		       sonic_ext_punt_tx_t *tx, u32 next_index, u16 queue_id,
+		       u32 bi)
+{
+  vnet_hw_if_tx_frame_t *tf;
+
+  if (tx->f && (tx->next_index != next_index || tx->queue_id != queue_id ||
+		tx->to - (u32 *) vlib_frame_vector_args (tx->f) ==
+		  VLIB_FRAME_SIZE))
+    sonic_ext_punt_tx_flush (vm, node, tx);
+
+  if (!tx->f)
+    {
+      /* The queue is usually not the one this thread owns, so always
+       * ask the TX node to take the queue lock. */
+      tx->f = vlib_get_next_frame_internal (vm, node, next_index, 1);
+      tf = vlib_frame_scalar_args (tx->f);
+      clib_memset (tf, 0, sizeof (*tf));
+      tf->queue_id = queue_id;
+      tf->shared_queue = 1;
+      tx->to = vlib_frame_vector_args (tx->f);
+      tx->next_index = next_index;
+      tx->queue_id = queue_id;
+    }
+
+  *tx->to++ = bi;
+}
+
+/* Steer the packets marked in `cls` (~0 = not steered) class by class,
+ * highest priority first.  Returns the number of frame-limit drops queued in
+ * drops[]. */
+static_always_inline u32
+sonic_ext_punt_steer (vlib_main_t *vm, vlib_node_runtime_t *node,
+		      vlib_buffer_t **b, u32 *from, u8 *cls, u32 n,
+		      u32 *drops)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  vnet_main_t *vnm = vnet_get_main ();
+  vnet_interface_main_t *im = &vnm->interface_main;
+  sonic_ext_punt_tx_t tx = { 0 };
+  u32 n_tx[SONIC_EXT_COPP_N_CLASSES] = { 0 };
+  u32 n_drop[SONIC_EXT_COPP_N_CLASSES] = { 0 };
+  u32 n_drops = 0, prio, c, i;
+
+  for (prio = 0; prio < SONIC_EXT_PUNT_N_PRIOS; prio++)
+    for (c = 0; c < SONIC_EXT_COPP_N_CLASSES; c++)
+      {
+	sonic_ext_punt_queue_cfg_t *qc = &sem->punt_queues[c];
+
+	if (qc->priority != prio)
+	  continue;
+
+	for (i = 0; i < n; i++)
+	  {
+	    vnet_hw_interface_t *hi;
+	    u32 tap, nq, qi;
+
+	    if (cls[i] != c)
+	      continue;
+
+	    if (qc->frame_limit && n_tx[c] >= qc->frame_limit)
+	      {
+		b[i]->error = node->errors[SONIC_EXT_COPP_ERROR_FRAME_LIMIT];
+		drops[n_drops++] = from[i];
+		n_drop[c]++;
+		continue;
+	      }
+
+	    tap = vnet_buffer (b[i])->sw_if_index[VLIB_TX];
+	    hi = vnet_get_sup_hw_interface (vnm, tap);
+	    nq = vec_len (hi->tx_queue_indices);
+	    qi = hi->tx_queue_indices[qc->queue % nq];
+
+	    sonic_ext_punt_tx_one (vm, node, &tx, sonic_ext_host_tx_next (tap),
+				   vnet_hw_if_get_tx_queue (vnm, qi)->queue_id,
+				   from[i]);
+	    /* interface-output is skipped and the device TX node does not
+	     * count, so the tap's TX counter is bumped here. */
+	    vlib_increment_combined_counter (
+	      im->combined_sw_if_counters + VNET_INTERFACE_COUNTER_TX,
+	      vm->thread_index, tap, 1, vlib_buffer_length_in_chain (vm, b[i]));
+	    n_tx[c]++;
+	  }
+      }
+
+  sonic_ext_punt_tx_flush (vm, node, &tx);
+
+  for (c = 0; c < SONIC_EXT_COPP_N_CLASSES; c++)
+    {
+      if (n_tx[c])
+	vlib_increment_simple_counter (&sem->punt_queue_steered,
+				       vm->thread_index, c, n_tx[c]);
+      if (n_drop[c])
+	vlib_increment_simple_counter (&sem->punt_queue_limit_drops,
+				       vm->thread_index, c, n_drop[c]);
+    }
+
+  return n_drops;
+}
+
+/* Can packets for this host tap be steered to a per-class queue? */
+static_always_inline int
+sonic_ext_punt_steerable (u32 tap)
+{
+  vnet_hw_interface_t *hi;
+
+  if (sonic_ext_host_tx_next (tap) == ~0)
+    return 0;
+  hi = vnet_get_sup_hw_interface (vnet_get_main (), tap);
+  return vec_len (hi->tx_queue_indices) > 1;
+}
+
+VLIB_NODE_FN (sonic_ext_copp_node)
+(vlib_main_t *vm, vlib_node_runtime_t *node, vlib_frame_t *frame)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  u32 n_left_from, *from;
+  vlib_buffer_t *bufs[VLIB_FRAME_SIZE], **b;
+  u16 nexts[VLIB_FRAME_SIZE];
+  u32 rest[VLIB_FRAME_SIZE], drops[VLIB_FRAME_SIZE];
+  u8 classes[VLIB_FRAME_SIZE], cls[VLIB_FRAME_SIZE];
+  u32 n_class[SONIC_EXT_COPP_N_CLASSES] = { 0 };
+  u32 n_passed[SONIC_EXT_COPP_N_CLASSES] = { 0 };
+  u32 n_dropped[SONIC_EXT_COPP_N_CLASSES] = { 0 };
+  u32 n_pass = 0, n_drop = 0, n_rest = 0, n_steer = 0, n_qdrop;
+  u32 last_tap = ~0;
+  int steer = 0;
+  f64 now = vlib_time_now (vm);
+  u32 ts_now = sem->latency_enabled ? sonic_ext_latency_now () : 0;
+  u32 i;
+
+  from = vlib_frame_vector_args (frame);
+  n_left_from = frame->n_vectors;
+  vlib_get_buffers (vm, from, bufs, n_left_from);
+  b = bufs;
+
+  for (i = 0; i < n_left_from; i++)
+    {
+      if (i + 2 < n_left_from)
+	vlib_prefetch_buffer_data (b[i + 2], LOAD);
+
+      {
+	sonic_ext_buffer_opaque_t *seb = sonic_ext_buffer (b[i]);
+	/* Sample only a live cookie: a consumed one was sampled at its
+	 * redirect.  The packet leaves VPP here either way, so the cookie
+	 * is cleared whatever it was, latency on or off. */
+	if (PREDICT_FALSE (ts_now) && seb->magic == SONIC_EXT_BUFFER_MAGIC)
+	  sonic_ext_latency_record (vm, SONIC_EXT_LATENCY_EXIT_TAP_TX, seb,
+				    ts_now);
+	seb->magic = 0;
+      }
+
+      classes[i] = sonic_ext_copp_classify (b[i]);
+      n_class[classes[i]]++;
+    }
+
+  /* From here on n_class[] is what each class may still pass. */
+  for (i = 0; i < SONIC_EXT_COPP_N_CLASSES; i++)
+    if (n_class[i])
+      n_class[i] = sonic_ext_copp_police (
+	&sem->copp_buckets[i], &sem->copp_classes[i], n_class[i], now);
+
+  for (i = 0; i < n_left_from; i++)
+    {
+      sonic_ext_copp_class_t c0 = classes[i];
+      u32 tap0 = vnet_buffer (b[i])->sw_if_index[VLIB_TX];
+      int pass0 = n_class[c0] != 0;
+
+      n_class[c0] -= pass0;
+      cls[i] = ~0;
+
+      if (PREDICT_FALSE (sem->punt_prio && tap0 != last_tap))
+	{
+	  last_tap = tap0;
+	  steer = sonic_ext_punt_steerable (tap0);
+	}
+
+      if (PREDICT_TRUE (pass0))
+	{
+	  n_passed[c0]++;
+	  if (PREDICT_FALSE (sem->punt_prio && steer))
+	    {
+	      cls[i] = c0;
+	      n_steer++;
+	    }
+	  else
+	    {
+	      vnet_feature_next_u16 (nexts + n_rest, b[i]);
+	      rest[n_rest++] = from[i];
+	    }
+	}
+      else
+	{
+	  nexts[n_rest] = SONIC_EXT_COPP_NEXT_DROP;
+	  rest[n_rest++] = from[i];
+	  b[i]->error = node->errors[SONIC_EXT_COPP_ERROR_POLICED];
+	  n_dropped[c0]++;
+	}
+
+      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE) &&
+			 (b[i]->flags & VLIB_BUFFER_IS_TRACED)))
+	{
+	  sonic_ext_copp_trace_t *t =
+	    vlib_add_trace (vm, node, b[i], sizeof (*t));
+	  t->sw_if_index = tap0;
+	  t->class = c0;
+	  t->dropped = !pass0;
+	}
+    }
+
+  if (n_rest)
+    vlib_buffer_enqueue_to_next (vm, node, rest, nexts, n_rest);
+
+  if (n_steer)
+    {
+      n_qdrop = sonic_ext_punt_steer (vm, node, bufs, from, cls,
+				      frame->n_vectors, drops);
+      if (n_qdrop)
+	vlib_buffer_enqueue_to_single_next (vm, node, drops,
+					    SONIC_EXT_COPP_NEXT_DROP, n_qdrop);
+    }
+
+  for (i = 0; i < SONIC_EXT_COPP_N_CLASSES; i++)
+    {
+      if (n_passed[i])
+	vlib_increment_simple_counter (&sem->copp_passed, vm->thread_index, i,
+				       n_passed[i]);
+      if (n_dropped[i])
+	vlib_increment_simple_counter (&sem->copp_dropped, vm->thread_index,
+				       i, n_dropped[i]);
+      n_pass += n_passed[i];
+      n_drop += n_dropped[i];
+    }
+
+  if (n_pass)
+    vlib_node_increment_counter (vm, sonic_ext_copp_node.index,
+				 SONIC_EXT_COPP_ERROR_PASSED, n_pass);
+  if (n_drop)
+    vlib_node_increment_counter (vm, sonic_ext_copp_node.index,
+				 SONIC_EXT_COPP_ERROR_POLICED, n_drop);
+
+  return frame->n_vectors;
+}
+
+VLIB_REGISTER_NODE (sonic_ext_copp_node) = {
+  .name = "sonic-ext-copp",
+  .vector_size = sizeof (u32),
+  .format_trace = format_sonic_ext_copp_trace,
+  .type = VLIB_NODE_TYPE_INTERNAL,
+  .n_errors = ARRAY_LEN (sonic_ext_copp_error_strings),
+  .error_strings = sonic_ext_copp_error_strings,
+  .n_next_nodes = SONIC_EXT_COPP_N_NEXT,
+  .next_nodes = {
+    [SONIC_EXT_COPP_NEXT_DROP] = "error-drop",
+  },
+};
+
+VNET_FEATURE_INIT (sonic_ext_copp_feat, static) = {
+  .arc_name = "interface-output",
+  .node_name = "sonic-ext-copp",
+  /* Police on the tap the packet is actually delivered to, i.e. after
+   * a possible aggregate -> member redirect. */
+  .runs_after = VNET_FEATURES ("sonic-ext-aggr-tap-redirect"),
+};
@@ -18,7 +18,6 @@
 #include <vnet/vnet.h>
 #include <vnet/feature/feature.h>
 #include <vnet/adj/adj.h>
-#include <vnet/util/throttle.h>
 
 /*
  * sonic-ext-glean-redirect
@@ -29,7 +28,7 @@
  * ip_punt_drop.h.  Run-time control is sem->punt_via_member.
  *
  * The node therefore sees every dropped packet in the system and does
- * its own filtering; see sonic_ext_glean_src_nodes below.
+ * its own filtering; see sonic_ext_glean_from_nbr_node below.
  *
  * PROBLEM.  A transit packet whose next-hop is a directly-connected
  * neighbour that has NOT yet been resolved hits a *glean* (connected
@@ -60,11 +59,15 @@
  * reverse-path filtering passes: the packet's source is a connected
  * neighbour of the ingress sub-interface.
  *
- * A per-(adjacency) throttle rate-limits the redirect so a genuinely
- * unreachable destination cannot flood the CPU: one punt copy per
- * throttle window is enough to (re)arm the kernel's own ARP.  Once the
- * neighbour resolves via SAI the packets forward in VPP and never
- * reach this node again.
+ * A per-(adjacency, ingress) throttle rate-limits the redirect so a
+ * genuinely unreachable destination cannot flood the CPU: one punt copy
+ * per throttle window is enough to (re)arm the kernel's own ARP.  Once
+ * the neighbour resolves via SAI the packets forward in VPP and never
+ * reach this node again.  The throttle alone does not bound the load
+ * when a whole subnet goes unresolved -- every destination is its own
+ * adjacency -- so optional per-ingress-port and global budgets (packets
+ * per second) cap what reaches the kernel ARP stack; see
+ * sonic_ext_set_glean_limits.
  */
 
 typedef struct
@@ -98,6 +101,8 @@ format_sonic_ext_glean_redirect_trace (u8 *s, va_list *args)
   _ (NO_COOKIE, "no capture cookie -- passed through")                        \
   _ (NO_LCP, "no LCP pair for ingress phy -- passed through")                 \
   _ (THROTTLED, "throttled -- passed through to drop")                        \
+  _ (RATE_LIMITED, "over port / global punt budget -- passed through to "    \
+		   "drop")                                                    \
   _ (DISABLED, "punt-via-member disabled -- passed through")
 
 typedef enum
@@ -120,12 +125,9 @@ typedef enum
   SONIC_EXT_GLEAN_REDIRECT_N_NEXT,
 } sonic_ext_glean_redirect_next_t;
 
-/* Rate-limit the redirect per resolving adjacency so an unreachable
- * destination cannot flood the CPU.  Seeded once threads are known. */
-static throttle_t sonic_ext_glean_throttle;
-
 /*
- * The only nodes whose drops we are allowed to steal.
+ * sem->glean_src_nodes: the only nodes whose drops we are allowed to
+ * steal (tested through sem->glean_src_errors, see below).
  *
  * This node is a feature on the ip4-drop / ip6-drop arcs, which are
  * dispatched with a hardcoded sw_if_index 0 (ip_punt_drop.h,
@@ -147,7 +149,9 @@ static throttle_t sonic_ext_glean_throttle;
  *
  * So gate on the node that produced the drop.  All of these stamp
  * b->error from their own node before enqueuing to the drop arc, and
- * vlib_error_get_node() maps that back to the node index.
+ * vlib_error_get_node() maps that back to the node index -- or, the
+ * other way round, every error code of those nodes is precomputed into
+ * the sem->glean_src_errors bitmap at main-loop enter.
  *
  * ip6-discover-neighbor is DELIBERATELY EXCLUDED.  Unlike its v4
  * counterpart it rewrites the packet in place before dropping it:
@@ -166,20 +170,13 @@ static throttle_t sonic_ext_glean_throttle;
  * unrecoverable, so v6 is glean-only.  v6 glean does not touch the
  * packet and is safe.
  */
-static u32 sonic_ext_glean_src_nodes[3];
-
 static_always_inline int
-sonic_ext_glean_from_nbr_node (vlib_main_t *vm, vlib_buffer_t *b)
+sonic_ext_glean_from_nbr_node (vlib_buffer_t *b)
 {
-  u32 ni = vlib_error_get_node (&vm->node_main, b->error);
-  int i;
-
-  for (i = 0; i < ARRAY_LEN (sonic_ext_glean_src_nodes); i++)
-    if (sonic_ext_glean_src_nodes[i] != ~0 &&
-	ni == sonic_ext_glean_src_nodes[i])
-      return 1;
-
-  return 0;
+  /* b->error encodes the node that set it (vlib_error_get_node); the
+   * bitmap holds every error code owned by one of the glean_src_nodes,
+   * so this is a single bit test -- no node lookup, no table scan. */
+  return clib_bitmap_get (sonic_ext_main.glean_src_errors, b->error);
 }
 
 /*
@@ -217,10 +214,7 @@ sonic_ext_glean_from_nbr_node (vlib_main_t *vm, vlib_buffer_t *b)
 static_always_inline int
 sonic_ext_glean_should_redirect (u32 adj_index)
 {
-  vnet_main_t *vnm = vnet_get_main ();
   ip_adjacency_t *adj;
-  vnet_sw_interface_t *swo;
-  u32 egress_sw;
 
   if (adj_index == ADJ_INDEX_INVALID || !adj_is_valid (adj_index))
     return 0;
@@ -230,14 +224,88 @@ sonic_ext_glean_should_redirect (u32 adj_index)
       adj->lookup_next_index != IP_LOOKUP_NEXT_ARP)
     return 0;
 
-  egress_sw = adj->rewrite_header.sw_if_index;
-  swo = vnet_get_sw_interface_or_null (vnm, egress_sw);
-  if (!swo)
-    return 0;
+  /* Egress interface still exists (flat table, see sonic_ext_sw_parent). */
+  return sonic_ext_sw_parent (adj->rewrite_header.sw_if_index) != ~0;
+}
 
+/*
+ * Token bucket in packets, burst one second's worth of rate (at least
+ * one packet); rate 0 means no budget.  Per thread, so nothing is
+ * shared between workers; see sonic_ext_glean_update_limits for the
+ * rate each thread enforces.
+ */
+static_always_inline int
+sonic_ext_glean_budget_take (sonic_ext_glean_bucket_t *bk, f64 rate, f64 now)
+{
+  f64 tokens;
+
+  if (rate == 0)
+    return 1;
+
+  tokens = bk->tokens + (now - bk->last) * rate;
+  bk->last = now;
+  tokens = clib_min (tokens, clib_max (rate, 1.0));
+
+  if (tokens < 1.0)
+    {
+      bk->tokens = tokens;
+      return 0;
+    }
+  bk->tokens = tokens - 1.0;
   return 1;
 }
 
+/* Ingress port budget first, then the global one; a port token is
+ * handed back if the global budget says no. */
+static_always_inline int
+sonic_ext_glean_budget_check (sonic_ext_main_t *sem,
+			      sonic_ext_glean_per_thread_t *pt, u32 orig_rx,
+			      f64 now)
+{
+  sonic_ext_glean_bucket_t *bk = 0;
+
+  if (orig_rx < vec_len (pt->by_if))
+    {
+      bk = vec_elt_at_index (pt->by_if, orig_rx);
+      if (!sonic_ext_glean_budget_take (bk, sem->glean_if_rate, now))
+	return 0;
+    }
+
+  if (!sonic_ext_glean_budget_take (&pt->global,
+				    sem->glean_thread_global_rate, now))
+    {
+      if (bk && sem->glean_if_rate != 0)
+	bk->tokens += 1.0;
+      return 0;
+    }
+  return 1;
+}
+
+static_always_inline void
+sonic_ext_glean_redirect_trace (vlib_main_t *vm, vlib_node_runtime_t *node,
+				vlib_buffer_t *b, u32 orig_rx, u32 host_tap,
+				u16 pushed_vlan_id, int did_redirect)
+{
+  if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE) &&
+		     (b->flags & VLIB_BUFFER_IS_TRACED)))
+    {
+      sonic_ext_glean_redirect_trace_t *t =
+	vlib_add_trace (vm, node, b, sizeof (*t));
+      t->orig_rx_sw_if_index = orig_rx;
+      t->host_tap_sw_if_index = host_tap;
+      t->pushed_vlan_id = pushed_vlan_id;
+      t->redirected = did_redirect;
+    }
+}
+
+/*
+ * The node sees every drop on the box, so it is written for the flood
+ * case: one pass over the frame sets the default (drop arc) next and
+ * tests each error code against the glean_src_errors bitmap, and only
+ * the -- normally zero -- packets that pass that gate get their
+ * adjacency prefetched and go through the full per-packet checks.  A
+ * frame with punt_via_member off does not even do the bitmap test.
+ */
 VLIB_NODE_FN (sonic_ext_glean_redirect_node)
 (vlib_main_t *vm, vlib_node_runtime_t *node, vlib_frame_t *frame)
 {
@@ -246,12 +314,14 @@ VLIB_NODE_FN (sonic_ext_glean_redirect_node)
   u32 n_left_from, *from;
   vlib_buffer_t *bufs[VLIB_FRAME_SIZE], **b;
   u16 nexts[VLIB_FRAME_SIZE], *next;
+  u16 cand[VLIB_FRAME_SIZE];
   u32 n_redirected = 0, n_not_glean = 0, n_no_cookie = 0, n_no_lcp = 0;
-  u32 n_throttled = 0, n_disabled = 0, n_not_nbr_node = 0;
+  u32 n_throttled = 0, n_rate_limited = 0, n_disabled = 0;
+  u32 n_not_nbr_node = 0, n_cand = 0, i, j;
+  sonic_ext_glean_per_thread_t *pt;
+  u32 ts_now = 0;
   u64 seed;
-
-  seed = throttle_seed (&sonic_ext_glean_throttle, thread_index,
-			vlib_time_now (vm));
+  f64 now;
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
@@ -259,11 +329,95 @@ VLIB_NODE_FN (sonic_ext_glean_redirect_node)
   b = bufs;
   next = nexts;
 
-  while (n_left_from > 0)
+  /* Default: continue down the drop arc (real drop).  The gate on the
+   * dropping node has to come before anything else: on any other drop
+   * path adj_index[VLIB_TX] is not an adjacency index at all (see the
+   * comment on sonic_ext_glean_from_nbr_node), so it is not safe to
+   * hand to adj_get(). */
+  if (PREDICT_FALSE (!sem->punt_via_member))
+    {
+      for (i = 0; i < n_left_from; i++)
+	vnet_feature_next_u16 (next + i, b[i]);
+      n_disabled = n_left_from;
+    }
+  else
+    {
+      i = 0;
+      while (i + 4 <= n_left_from)
+	{
+	  if (i + 12 <= n_left_from)
+	    {
+	      vlib_prefetch_buffer_header (b[i + 8], LOAD);
+	      vlib_prefetch_buffer_header (b[i + 9], LOAD);
+	      vlib_prefetch_buffer_header (b[i + 10], LOAD);
+	      vlib_prefetch_buffer_header (b[i + 11], LOAD);
+	    }
+
+	  vnet_feature_next_u16 (next + i, b[i]);
+	  vnet_feature_next_u16 (next + i + 1, b[i + 1]);
+	  vnet_feature_next_u16 (next + i + 2, b[i + 2]);
+	  vnet_feature_next_u16 (next + i + 3, b[i + 3]);
+
+	  /* Branch-free append: the slot is always written, the count
+	   * only advances on a hit. */
+	  cand[n_cand] = i;
+	  n_cand += sonic_ext_glean_from_nbr_node (b[i]);
+	  cand[n_cand] = i + 1;
+	  n_cand += sonic_ext_glean_from_nbr_node (b[i + 1]);
+	  cand[n_cand] = i + 2;
+	  n_cand += sonic_ext_glean_from_nbr_node (b[i + 2]);
+	  cand[n_cand] = i + 3;
+	  n_cand += sonic_ext_glean_from_nbr_node (b[i + 3]);
+	  i += 4;
+	}
+      for (; i < n_left_from; i++)
+	{
+	  vnet_feature_next_u16 (next + i, b[i]);
+	  cand[n_cand] = i;
+	  n_cand += sonic_ext_glean_from_nbr_node (b[i]);
+	}
+      n_not_nbr_node = n_left_from - n_cand;
+    }
+
+  if (PREDICT_FALSE (node->flags & VLIB_NODE_FLAG_TRACE))
     {
-      u32 next0 = 0;
+      /* Trace the packets the gate let through below, everyone else
+       * here.  cand[] is ascending, so walk it alongside. */
+      for (i = 0, j = 0; i < n_left_from; i++)
+	{
+	  if (j < n_cand && cand[j] == i)
+	    {
+	      j++;
+	      continue;
+	    }
+	  sonic_ext_glean_redirect_trace (vm, node, b[i], ~0, ~0, 0, 0);
+	}
+    }
+
+  if (PREDICT_TRUE (n_cand == 0))
+    goto done;
+
+  /* Candidates only from here on -- they all came from a neighbour
+   * resolution node, so adj_index[VLIB_TX] is a real adjacency. */
+  for (j = 0; j < n_cand; j++)
+    {
+      u32 ai = vnet_buffer (b[cand[j]])->ip.adj_index[VLIB_TX];
+      if (ai != ADJ_INDEX_INVALID && adj_is_valid (ai))
+	clib_prefetch_load (adj_get (ai));
+      clib_prefetch_load (sonic_ext_buffer (b[cand[j]]));
+    }
+
+  now = vlib_time_now (vm);
+  seed = throttle_seed (&sem->glean_throttle, thread_index, now);
+  pt = vec_elt_at_index (sem->glean_per_thread, thread_index);
+  if (PREDICT_FALSE (sem->latency_enabled))
+    ts_now = sonic_ext_latency_now ();
+
+  for (j = 0; j < n_cand; j++)
+    {
+      vlib_buffer_t *b0 = b[cand[j]];
       sonic_ext_buffer_opaque_t *seb;
-      u32 adj_index0 = vnet_buffer (b[0])->ip.adj_index[VLIB_TX];
+      u32 adj_index0 = vnet_buffer (b0)->ip.adj_index[VLIB_TX];
       u32 orig_rx = ~0;
       u32 host_tap = ~0;
       u16 pushed_tpid = 0;
@@ -271,38 +425,15 @@ VLIB_NODE_FN (sonic_ext_glean_redirect_node)
       int did_redirect = 0;
       u64 key;
 
-      /* Default: continue down the drop arc (real drop). */
-      vnet_feature_next (&next0, b[0]);
-      next[0] = (u16) next0;
-
-      if (PREDICT_FALSE (!sem->punt_via_member))
-	{
-	  n_disabled++;
-	  goto trace0;
-	}
-
-      /* Only steal packets a neighbour-resolution node dropped, and
-       * only when their VLIB_TX adjacency really is an unresolved
-       * connected (glean) or incomplete (arp) adjacency.  Every other
-       * ip4-drop / ip6-drop reason falls straight through.
-       *
-       * The node gate has to come first: on any other drop path
-       * adj_index[VLIB_TX] is not an adjacency index at all (see the
-       * comment on sonic_ext_glean_src_nodes), so it is not safe to
-       * hand to adj_get(). */
-      if (!sonic_ext_glean_from_nbr_node (vm, b[0]))
-	{
-	  n_not_nbr_node++;
-	  goto trace0;
-	}
-
+      /* Only when the VLIB_TX adjacency really is an unresolved
+       * connected (glean) or incomplete (arp) adjacency. */
       if (!sonic_ext_glean_should_redirect (adj_index0))
 	{
 	  n_not_glean++;
 	  goto trace0;
 	}
 
-      seb = sonic_ext_buffer (b[0]);
+      seb = sonic_ext_buffer (b0);
       if (PREDICT_FALSE (seb->magic != SONIC_EXT_BUFFER_MAGIC))
 	{
 	  n_no_cookie++;
@@ -314,40 +445,44 @@ VLIB_NODE_FN (sonic_ext_glean_redirect_node)
        * enough to (re)arm the kernel's own ARP; the rest keep
        * dropping until the neighbour is programmed via SAI. */
       key = ((u64) adj_index0 << 32) | orig_rx;
-      if (throttle_check (&sonic_ext_glean_throttle, thread_index, key, seed))
+      if (throttle_check (&sem->glean_throttle, thread_index, key, seed))
 	{
 	  n_throttled++;
+	  sonic_ext_if_counter_add (vm, &sem->if_glean_throttled, orig_rx, 1);
+	  goto trace0;
+	}
+
+      /* Many adjacencies at once (a whole subnet unresolved) each pass
+       * the throttle; the budgets bound the total. */
+      if (PREDICT_FALSE (!sonic_ext_glean_budget_check (sem, pt, orig_rx,
+							 now)))
+	{
+	  n_rate_limited++;
+	  sonic_ext_if_counter_add (vm, &sem->if_glean_throttled, orig_rx, 1);
 	  goto trace0;
 	}
 
       if (PREDICT_FALSE (!sonic_ext_redirect_to_ingress_tap (
-	    b[0], orig_rx, ~0, &host_tap, &pushed_tpid, &pushed_vlan_id)))
+	    b0, orig_rx, ~0, &host_tap, &pushed_tpid, &pushed_vlan_id)))
 	{
 	  n_no_lcp++;
 	  goto trace0;
 	}
 
-      next[0] = SONIC_EXT_GLEAN_REDIRECT_NEXT_INTERFACE_OUTPUT;
+      next[cand[j]] = SONIC_EXT_GLEAN_REDIRECT_NEXT_INTERFACE_OUTPUT;
       did_redirect = 1;
       n_redirected++;
+      sonic_ext_if_counter_add (vm, &sem->if_punt_redirects, orig_rx, 1);
+      if (PREDICT_FALSE (ts_now))
+	sonic_ext_latency_record (vm, SONIC_EXT_LATENCY_EXIT_GLEAN, seb,
+				  ts_now);
 
     trace0:
-      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE) &&
-			 (b[0]->flags & VLIB_BUFFER_IS_TRACED)))
-	{
-	  sonic_ext_glean_redirect_trace_t *t =
-	    vlib_add_trace (vm, node, b[0], sizeof (*t));
-	  t->orig_rx_sw_if_index = orig_rx;
-	  t->host_tap_sw_if_index = host_tap;
-	  t->pushed_vlan_id = pushed_vlan_id;
-	  t->redirected = did_redirect;
-	}
-
-      b += 1;
-      next += 1;
-      n_left_from -= 1;
+      sonic_ext_glean_redirect_trace (vm, node, b0, orig_rx, host_tap,
+				      pushed_vlan_id, did_redirect);
     }
 
+done:
   vlib_buffer_enqueue_to_next (vm, node, from, nexts, frame->n_vectors);
 
 #define _inc(SYM, N)                                                          \
@@ -360,10 +495,11 @@ VLIB_NODE_FN (sonic_ext_glean_redirect_node)
   _inc (NO_COOKIE, n_no_cookie);
   _inc (NO_LCP, n_no_lcp);
   _inc (THROTTLED, n_throttled);
+  _inc (RATE_LIMITED, n_rate_limited);
   _inc (DISABLED, n_disabled);
 #undef _inc
 
-  sem->glean_redirects += n_redirected;
+  sonic_ext_counter_add (vm, SONIC_EXT_COUNTER_GLEAN_REDIRECTS, n_redirected);
   return frame->n_vectors;
 }
 
@@ -395,42 +531,55 @@ VNET_FEATURE_INIT (sonic_ext_glean_redirect_ip6, static) = {
   .node_name = "sonic-ext-glean-redirect",
 };
 
+#ifndef CLIB_MARCH_VARIANT
 static clib_error_t *
 sonic_ext_glean_redirect_main_loop_enter (vlib_main_t *vm)
 {
+  sonic_ext_main_t *sem = &sonic_ext_main;
   vlib_thread_main_t *tm = &vlib_thread_main;
   /* v6 is glean-only on purpose -- ip6-discover-neighbor mangles the
    * packet's destination address before dropping it.  See the comment
-   * on sonic_ext_glean_src_nodes. */
+   * on sonic_ext_glean_from_nbr_node. */
   static const char *const nbr_node_names[] = { "ip4-arp", "ip4-glean",
 						"ip6-glean" };
-  int i;
+  int i, j;
 
   STATIC_ASSERT (ARRAY_LEN (nbr_node_names) ==
-		   ARRAY_LEN (sonic_ext_glean_src_nodes),
+		   ARRAY_LEN (sem->glean_src_nodes),
 		 "neighbour-resolution node table size mismatch");
 
   for (i = 0; i < ARRAY_LEN (nbr_node_names); i++)
     {
       vlib_node_t *n = vlib_get_node_by_name (vm, (u8 *) nbr_node_names[i]);
 
-      sonic_ext_glean_src_nodes[i] = n ? n->index : ~0;
+      sem->glean_src_nodes[i] = n ? n->index : ~0;
       if (!n)
-	clib_warning ("sonic-ext glean-redirect: node '%s' not found; drops "
-		      "from it will not be redirected",
-		      nbr_node_names[i]);
+	{
+	  clib_warning ("sonic-ext glean-redirect: node '%s' not found; "
+			"drops from it will not be redirected",
+			nbr_node_names[i]);
+	  continue;
+	}
+
+      /* A node's error codes are the contiguous block starting at its
+       * error_heap_index (vlib_error_get_node is the inverse). */
+      for (j = 0; j < n->n_errors; j++)
+	sem->glean_src_errors =
+	  clib_bitmap_set (sem->glean_src_errors, n->error_heap_index + j, 1);
     }
 
-  /* ~1ms window, matching VPP's own ARP throttle granularity.  MUST be
+  /* glean_window defaults to ~1ms, matching VPP's own ARP throttle
+   * granularity (see sonic_ext_set_glean_limits).  MUST be
    * a main-loop-enter function (not VLIB_INIT_FUNCTION): the throttle's
    * per-thread arrays are sized from n_vlib_mains, which only includes
    * the worker threads once they have been started -- init-function time
    * is too early, and an undersized array makes a worker's
    * throttle_seed / throttle_check read out of bounds.  This mirrors
    * ip4_neighbor's arp_throttle (ip4_neighbor_main_loop_enter). */
-  throttle_init (&sonic_ext_glean_throttle, tm->n_vlib_mains, THROTTLE_BITS,
-		 1e-3);
+  throttle_init (&sem->glean_throttle, tm->n_vlib_mains, THROTTLE_BITS,
+		 sem->glean_window);
   return 0;
 }
 
 VLIB_MAIN_LOOP_ENTER_FUNCTION (sonic_ext_glean_redirect_main_loop_enter);
+#endif /* CLIB_MARCH_VARIANT */
@@ -48,6 +48,16 @@
  *
  * If the ingress sw_if_index is not an LCP host tap, the node is a
  * no-op (it lets the packet continue on the feature arc).
+ *
+ * Direct-to-TX ("sonic-ext host-xc direct-tx on"): when the whole frame
+ * came from one host tap, the node can also skip interface-output and
+ * hand the frame straight to the phy's device TX node (hw
+ * tx_node_index).  That is only done when interface-output would have
+ * nothing to do beyond counting and setting the TX queue, which the
+ * node then does itself: the phy must be up, have no output features,
+ * a single TX queue for this thread, and do in hardware whatever
+ * checksum / GSO offload the buffers carry.  Otherwise the frame takes
+ * the regular interface-output path.
  */
 
 typedef struct
@@ -61,6 +71,7 @@ enum
 {
   SONIC_EXT_HOST_XC_MODE_PASSTHRU = 0,
   SONIC_EXT_HOST_XC_MODE_DIRECT,
+  SONIC_EXT_HOST_XC_MODE_DIRECT_TX,
 };
 
 static u8 *
@@ -73,6 +84,8 @@ format_sonic_ext_host_xc_trace (u8 *s, va_list *args)
   char *mode = "passthru";
   if (t->mode == SONIC_EXT_HOST_XC_MODE_DIRECT)
     mode = "DIRECT->interface-output";
+  else if (t->mode == SONIC_EXT_HOST_XC_MODE_DIRECT_TX)
+    mode = "DIRECT->device-tx";
   s = format (s, "SONIC-EXT-HOST-XC: rx %u phy %u %s", t->rx_sw_if_index,
 	      t->phy_sw_if_index, mode);
   return s;
@@ -80,6 +93,7 @@ format_sonic_ext_host_xc_trace (u8 *s, va_list *args)
 
 #define foreach_sonic_ext_host_xc_error                                       \
   _ (DIRECT, "host tap steered directly to phy interface-output")             \
+  _ (DIRECT_TX, "host tap steered directly to phy device tx")                 \
   _ (PASSTHRU, "not an LCP host tap, passthru")
 
 typedef enum
@@ -103,6 +117,98 @@ typedef enum
   SONIC_EXT_HOST_XC_N_NEXT,
 } sonic_ext_host_xc_next_t;
 
+/*
+ * Try to send the whole frame straight to the phy's TX node.  Returns 0
+ * (having touched nothing but VLIB_TX) if any precondition fails, in
+ * which case the caller runs the regular per-packet path.
+ */
+static_always_inline int
+sonic_ext_host_xc_direct_tx (vlib_main_t *vm, vlib_node_runtime_t *node,
+			     vlib_frame_t *frame, vlib_buffer_t **b)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  vnet_interface_main_t *im = &vnm->interface_main;
+  vnet_hw_if_output_node_runtime_t *r = 0;
+  vnet_hw_interface_t *hi;
+  vlib_frame_t *tf;
+  u32 *from = vlib_frame_vector_args (frame);
+  u32 n = frame->n_vectors;
+  u32 rx, phy, next_index, or_flags = 0, i;
+  u64 n_bytes = 0;
+
+  rx = vnet_buffer (b[0])->sw_if_index[VLIB_RX];
+  phy = sonic_ext_host_to_phy (rx);
+  next_index = sonic_ext_phy_tx_next (phy);
+  if (next_index == ~0)
+    return 0;
+
+  if (vnet_have_features (im->output_feature_arc_index, phy))
+    return 0;
+
+  hi = vnet_get_sup_hw_interface (vnm, phy);
+  if (!vnet_sw_interface_is_admin_up (vnm, phy) ||
+      !vnet_hw_interface_is_link_up (vnm, hi->hw_if_index))
+    return 0;
+
+  /* The TX queue comes from this thread's output runtime, as
+   * interface-output would take it; multi-queue TX needs its per-flow
+   * queue pick. */
+  if (!hi->output_node_thread_runtimes)
+    return 0;
+  r = vec_elt_at_index (hi->output_node_thread_runtimes, vm->thread_index);
+  if (r->n_queues != 1)
+    return 0;
+
+  for (i = 0; i < n; i++)
+    {
+      if (vnet_buffer (b[i])->sw_if_index[VLIB_RX] != rx)
+	return 0;
+      or_flags |= b[i]->flags;
+      n_bytes += vlib_buffer_length_in_chain (vm, b[i]);
+      vnet_buffer (b[i])->sw_if_index[VLIB_TX] = phy;
+    }
+
+  /* Super-frames and checksum offload from a GSO host tap stay on this
+   * path as long as the phy finishes them in hardware; otherwise
+   * interface-output (and the phy's gso feature) does it in software. */
+  if ((or_flags & VNET_BUFFER_F_GSO) && !(hi->caps & VNET_HW_IF_CAP_TCP_GSO))
+    return 0;
+  if ((or_flags & VNET_BUFFER_F_OFFLOAD) &&
+      (hi->caps & VNET_HW_IF_CAP_TX_CKSUM) != VNET_HW_IF_CAP_TX_CKSUM)
+    return 0;
+
+  /* Not vlib_buffer_enqueue_to_single_next: device TX nodes take their
+   * queue from the frame's scalar args, which interface-output would
+   * normally fill in, so we have to own the frame to set them. */
+  tf = vlib_get_next_frame_internal (vm, node, next_index, 1);
+  clib_memcpy_fast (vlib_frame_scalar_args (tf), r->frame,
+		    sizeof (vnet_hw_if_tx_frame_t));
+  vlib_buffer_copy_indices (vlib_frame_vector_args (tf), from, n);
+  vlib_put_next_frame (vm, node, next_index, VLIB_FRAME_SIZE - n);
+
+  /* Nor does the device TX node count: that is interface-output's job. */
+  vlib_increment_combined_counter (im->combined_sw_if_counters +
+				     VNET_INTERFACE_COUNTER_TX,
+				   vm->thread_index, phy, n, n_bytes);
+
+  if (PREDICT_FALSE (node->flags & VLIB_NODE_FLAG_TRACE))
+    for (i = 0; i < n; i++)
+      if (b[i]->flags & VLIB_BUFFER_IS_TRACED)
+	{
+	  sonic_ext_host_xc_trace_t *t =
+	    vlib_add_trace (vm, node, b[i], sizeof (*t));
+	  t->rx_sw_if_index = rx;
+	  t->phy_sw_if_index = phy;
+	  t->mode = SONIC_EXT_HOST_XC_MODE_DIRECT_TX;
+	}
+
+  vlib_node_increment_counter (vm, sonic_ext_host_xc_node.index,
+			       SONIC_EXT_HOST_XC_ERROR_DIRECT_TX, n);
+  sonic_ext_if_counter_add (vm, &sonic_ext_main.if_host_xc, phy, n);
+  sonic_ext_counter_add (vm, SONIC_EXT_COUNTER_HOST_XC_DIRECT, n);
+  return 1;
+}
+
 VLIB_NODE_FN (sonic_ext_host_xc_node)
 (vlib_main_t *vm, vlib_node_runtime_t *node, vlib_frame_t *frame)
 {
@@ -111,6 +217,7 @@ VLIB_NODE_FN (sonic_ext_host_xc_node)
   vlib_buffer_t *bufs[VLIB_FRAME_SIZE], **b;
   u16 nexts[VLIB_FRAME_SIZE], *next;
   u32 n_direct = 0, n_pass = 0;
+  u32 last_rx = ~0, last_phy = ~0;
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
@@ -118,26 +225,33 @@ VLIB_NODE_FN (sonic_ext_host_xc_node)
   b = bufs;
   next = nexts;
 
+  if (sem->host_xc && sem->host_xc_direct_tx &&
+      sonic_ext_host_xc_direct_tx (vm, node, frame, bufs))
+    return frame->n_vectors;
+
   while (n_left_from > 0)
     {
       u32 rx0, next0;
       u8 mode = SONIC_EXT_HOST_XC_MODE_PASSTHRU;
       u32 phy_sw = ~0;
-      index_t hlipi;
 
       rx0 = vnet_buffer (b[0])->sw_if_index[VLIB_RX];
 
       if (PREDICT_FALSE (!sem->host_xc))
 	goto passthru;
 
-      hlipi = lcp_itf_pair_find_by_host (rx0);
-      if (hlipi == INDEX_INVALID)
+      /* A device-input frame almost always comes from a single tap, so
+       * this is one table load per frame. */
+      if (PREDICT_FALSE (rx0 != last_rx))
+	{
+	  last_rx = rx0;
+	  last_phy = sonic_ext_host_to_phy (rx0);
+	}
+      phy_sw = last_phy;
+      if (phy_sw == ~0)
 	goto passthru;
 
       {
-	const lcp_itf_pair_t *hlip = lcp_itf_pair_get (hlipi);
-	phy_sw = hlip->lip_phy_sw_if_index;
-
 	/* Direct out the phy regardless of bridged / L3 -- the kernel
 	 * has already chosen the correct egress.  Bypass ethernet-
 	 * input and l2-input to avoid (a) static-MAC mac-move-violate
@@ -147,6 +261,7 @@ VLIB_NODE_FN (sonic_ext_host_xc_node)
 	next[0] = SONIC_EXT_HOST_XC_NEXT_INTF_OUTPUT;
 	mode = SONIC_EXT_HOST_XC_MODE_DIRECT;
 	n_direct++;
+	sonic_ext_if_counter_add (vm, &sem->if_host_xc, phy_sw, 1);
 	goto traced;
       }
 
@@ -179,7 +294,7 @@ VLIB_NODE_FN (sonic_ext_host_xc_node)
   if (n_pass)
     vlib_node_increment_counter (vm, sonic_ext_host_xc_node.index,
 				 SONIC_EXT_HOST_XC_ERROR_PASSTHRU, n_pass);
-  sem->host_xc_direct += n_direct;
+  sonic_ext_counter_add (vm, SONIC_EXT_COUNTER_HOST_XC_DIRECT, n_direct);
 
   return frame->n_vectors;
 }
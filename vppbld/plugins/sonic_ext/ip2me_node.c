@@ -50,11 +50,11 @@
  *
  * Fix.  Register this node on the l2-input-ip4 (and l2-input-ip6) feature
  * arc to run immediately BEFORE acl-plugin-in-ip4-l2.  For each frame we
- * do a FIB forwarding-lookup on the inner destination IP; if it resolves
- * to a local receive (DPO_RECEIVE), the destination is one of the
- * switch's own addresses (ip2me) and we steer the frame to
- * l2-input-feat-arc-end -- skipping the ACL plugin (and any later
- * l2-input-ip* features) -- so the rest of the l2-input chain still
+ * look the inner destination IP up in the ip2me local-address table of
+ * the port's FIB (sonic_ext_main_t.ip2me_local4/6); if it is there, the
+ * destination is one of the switch's own addresses (ip2me) and we steer
+ * the frame to l2-input-feat-arc-end -- skipping the ACL plugin (and any
+ * later l2-input-ip* features) -- so the rest of the l2-input chain still
  * runs and the packet reaches the BVI and ip4-local for the normal punt.
  * Everything else falls through to the ACL via vnet_feature_next(), so
  * transit / data traffic is dropped exactly as the ACL intends.
@@ -64,11 +64,21 @@
  * the sibling acl-plugin-in-ip*-l2 node uses on this same arc, so this node
  * decides ip2me on byte-for-byte the same header/interface the ACL would match.
  *
+ * The table holds the interface addresses, the receive routes VPP
+ * installs itself, so most ip2me traffic is answered by one exact-match
+ * probe.  Receive routes from elsewhere (SAI ip2me and loopback routes
+ * programmed "via local") are not in it, and VPP has no per-entry FIB
+ * notification to feed them in, so a miss is settled by the FIB lookup:
+ * an LPM resolving to DPO_RECEIVE is ip2me.  The IPv4 limited
+ * broadcast, the one receive route VPP installs on its own in every
+ * table, is checked inline.
+ *
  * Scope / caveats:
- *  - Unicast only.  The lookup is a unicast-FIB lookup, so a multicast
- *    destination (e.g. IPv6 ND to a solicited-node multicast) is never
- *    treated as ip2me and still falls through to the ACL.  This matches the
- *    IPv4 control/heartbeat use case; broader IPv6 ND handling is separate.
+ *  - Unicast only.  The table and the lookup are unicast, so a
+ *    multicast destination (e.g. IPv6 ND to a solicited-node multicast)
+ *    is never treated as ip2me and still falls through to the ACL.  This
+ *    matches the IPv4 control/heartbeat use case; broader IPv6 ND
+ *    handling is separate.
  *  - Single-VRF assumption.  The FIB is selected by the ingress member
  *    port's table (fib_index_by_sw_if_index[RX]), which is the default
  *    table for a plain bridged port.  In a multi-VRF bridge-domain where the
@@ -130,13 +140,9 @@ typedef enum
 
 /*
  * Returns non-zero if `dst` resolves, in the interface's FIB, to a local
- * receive DPO (i.e. an address owned by this switch -- the ip2me route
- * that VPP installs for every interface/loopback address).
- *
- * Fail-safe: any lookup anomaly (no FIB on this port, or a stale/invalid
- * load-balance index) returns 0 == "not ip2me", so the frame falls
- * through to the ACL exactly as it would without this node -- never a
- * crash, never worse than today's behavior.
+ * receive DPO.  Fail-safe: no FIB on this port, or a stale load-balance
+ * index, is "not ip2me", so the frame falls through to the ACL exactly
+ * as it would without this node.
  */
 static_always_inline int
 sonic_ext_dst_is_local_ip4 (u32 fib_index, const ip4_address_t *dst)
@@ -168,14 +174,98 @@ sonic_ext_dst_is_local_ip6 (u32 fib_index, const ip6_address_t *dst)
   return dpo->dpoi_type == DPO_RECEIVE;
 }
 
+/*
+ * Classify up to four packets (n is 4 or 1, a compile-time constant at
+ * every call site) as ip2me or not: build all the keys, hash them and
+ * prefetch their buckets first, then probe, so the bucket loads of a
+ * batch overlap.
+ *
+ * The FIB index only changes with the RX interface, and a frame on this
+ * arc is usually from a single port, so it is cached in *last_sw /
+ * *last_fib across batches: one compare per packet instead of a
+ * fib_index_by_sw_if_index load.  An interface past the end of that
+ * vector has no FIB yet.
+ *
+ * Fail-safe: no FIB on this port (fib_index ~0) never matches a key nor
+ * is looked up, so the frame falls through to the ACL exactly as it
+ * would without this node.
+ */
+static_always_inline void
+sonic_ext_ip2me_classify (sonic_ext_main_t *sem, vlib_buffer_t **b, u32 n,
+			  int is_ip6, u32 *last_sw, u32 *last_fib,
+			  u32 *fib_index, int *is_ip2me)
+{
+  u32 *fib_by_sw = is_ip6 ? ip6_main.fib_index_by_sw_if_index :
+			    ip4_main.fib_index_by_sw_if_index;
+  clib_bihash_kv_8_8_t kv4[4], value4;
+  clib_bihash_kv_24_8_t kv6[4], value6;
+  ip4_header_t *ip4[4];
+  ip6_header_t *ip6[4];
+  u64 hash[4];
+  u32 i;
+
+  for (i = 0; i < n; i++)
+    {
+      u8 *l3 = vlib_buffer_get_current (b[i]) +
+	       ethernet_buffer_header_size (b[i]);
+
+      u32 sw_if_index = vnet_buffer (b[i])->sw_if_index[VLIB_RX];
+
+      if (PREDICT_FALSE (sw_if_index != *last_sw))
+	{
+	  *last_sw = sw_if_index;
+	  *last_fib = sw_if_index < vec_len (fib_by_sw) ?
+			vec_elt (fib_by_sw, sw_if_index) :
+			~0;
+	}
+      fib_index[i] = *last_fib;
+      if (is_ip6)
+	{
+	  ip6[i] = (ip6_header_t *) l3;
+	  sonic_ext_ip2me_key6 (&kv6[i], fib_index[i], &ip6[i]->dst_address);
+	  hash[i] = clib_bihash_hash_24_8 (&kv6[i]);
+	  clib_bihash_prefetch_bucket_24_8 (&sem->ip2me_local6, hash[i]);
+	}
+      else
+	{
+	  ip4[i] = (ip4_header_t *) l3;
+	  sonic_ext_ip2me_key4 (&kv4[i], fib_index[i], &ip4[i]->dst_address);
+	  hash[i] = clib_bihash_hash_8_8 (&kv4[i]);
+	  clib_bihash_prefetch_bucket_8_8 (&sem->ip2me_local4, hash[i]);
+	}
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      if (is_ip6)
+	is_ip2me[i] = !clib_bihash_search_inline_2_with_hash_24_8 (
+	  &sem->ip2me_local6, hash[i], &kv6[i], &value6);
+      else
+	is_ip2me[i] =
+	  !clib_bihash_search_inline_2_with_hash_8_8 (
+	    &sem->ip2me_local4, hash[i], &kv4[i], &value4) ||
+	  (ip4[i]->dst_address.as_u32 == 0xffffffff && fib_index[i] != ~0);
+    }
+
+  /* Not an interface address: a receive route from elsewhere? */
+  for (i = 0; i < n; i++)
+    if (!is_ip2me[i])
+      is_ip2me[i] =
+	is_ip6 ?
+	  sonic_ext_dst_is_local_ip6 (fib_index[i], &ip6[i]->dst_address) :
+	  sonic_ext_dst_is_local_ip4 (fib_index[i], &ip4[i]->dst_address);
+}
+
 static_always_inline uword
 sonic_ext_ip2me_inline (vlib_main_t *vm, vlib_node_runtime_t *node,
 			vlib_frame_t *frame, int is_ip6)
 {
+  sonic_ext_main_t *sem = &sonic_ext_main;
   u32 n_left_from, *from;
   vlib_buffer_t *bufs[VLIB_FRAME_SIZE], **b;
   u16 nexts[VLIB_FRAME_SIZE], *next;
   u32 n_ip2me = 0, n_pass = 0;
+  u32 last_sw = ~0, last_fib = ~0;
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
@@ -185,60 +275,72 @@ sonic_ext_ip2me_inline (vlib_main_t *vm, vlib_node_runtime_t *node,
 
   while (n_left_from > 0)
     {
-      u32 next0;
-      u32 sw_if_index0 = vnet_buffer (b[0])->sw_if_index[VLIB_RX];
-      u32 fib_index0;
-      u8 *l3 = vlib_buffer_get_current (b[0]) +
-	       ethernet_buffer_header_size (b[0]);
-      int is_ip2me;
+      u32 fib_index[4];
+      int is_ip2me[4];
+      u32 i, n;
 
-      if (is_ip6)
+      if (n_left_from >= 4)
 	{
-	  ip6_header_t *ip6 = (ip6_header_t *) l3;
-	  fib_index0 =
-	    vec_elt (ip6_main.fib_index_by_sw_if_index, sw_if_index0);
-	  is_ip2me = sonic_ext_dst_is_local_ip6 (fib_index0, &ip6->dst_address);
+	  /* Two batches ahead: the buffer header (RX interface, l2_len);
+	   * one batch ahead: the packet data holding the L3 header. */
+	  if (n_left_from >= 12)
+	    {
+	      vlib_prefetch_buffer_header (b[8], LOAD);
+	      vlib_prefetch_buffer_header (b[9], LOAD);
+	      vlib_prefetch_buffer_header (b[10], LOAD);
+	      vlib_prefetch_buffer_header (b[11], LOAD);
+	    }
+	  if (n_left_from >= 8)
+	    {
+	      vlib_prefetch_buffer_data (b[4], LOAD);
+	      vlib_prefetch_buffer_data (b[5], LOAD);
+	      vlib_prefetch_buffer_data (b[6], LOAD);
+	      vlib_prefetch_buffer_data (b[7], LOAD);
+	    }
+	  n = 4;
+	  sonic_ext_ip2me_classify (sem, b, 4, is_ip6, &last_sw, &last_fib,
+				    fib_index, is_ip2me);
 	}
       else
 	{
-	  ip4_header_t *ip4 = (ip4_header_t *) l3;
-	  fib_index0 =
-	    vec_elt (ip4_main.fib_index_by_sw_if_index, sw_if_index0);
-	  is_ip2me = sonic_ext_dst_is_local_ip4 (fib_index0, &ip4->dst_address);
+	  n = 1;
+	  sonic_ext_ip2me_classify (sem, b, 1, is_ip6, &last_sw, &last_fib,
+				    fib_index, is_ip2me);
 	}
 
-      if (is_ip2me)
-	{
-	  /* ip2me: skip the ACL (and any later l2-input-ip* feature) by
-	   * jumping to the arc-end node; the rest of the l2-input chain
-	   * (vtr / learn / fwd) still runs, so the frame reaches the BVI
-	   * and ip*-local. */
-	  next0 = SONIC_EXT_IP2ME_NEXT_ARC_END;
-	  n_ip2me++;
-	}
-      else
+      for (i = 0; i < n; i++)
 	{
-	  /* Transit / data: continue on the arc to the ACL plugin. */
-	  vnet_feature_next (&next0, b[0]);
-	  n_pass++;
-	}
+	  if (is_ip2me[i])
+	    {
+	      /* ip2me: skip the ACL (and any later l2-input-ip* feature)
+	       * by jumping to the arc-end node; the rest of the l2-input
+	       * chain (vtr / learn / fwd) still runs, so the frame reaches
+	       * the BVI and ip*-local. */
+	      next[i] = SONIC_EXT_IP2ME_NEXT_ARC_END;
+	      n_ip2me++;
+	    }
+	  else
+	    {
+	      /* Transit / data: continue on the arc to the ACL plugin. */
+	      vnet_feature_next_u16 (next + i, b[i]);
+	      n_pass++;
+	    }
 
-      next[0] = (u16) next0;
-
-      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE) &&
-			 (b[0]->flags & VLIB_BUFFER_IS_TRACED)))
-	{
-	  sonic_ext_ip2me_trace_t *t =
-	    vlib_add_trace (vm, node, b[0], sizeof (*t));
-	  t->sw_if_index = sw_if_index0;
-	  t->fib_index = fib_index0;
-	  t->is_ip6 = (u8) is_ip6;
-	  t->is_ip2me = (u8) is_ip2me;
+	  if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE) &&
+			     (b[i]->flags & VLIB_BUFFER_IS_TRACED)))
+	    {
+	      sonic_ext_ip2me_trace_t *t =
+		vlib_add_trace (vm, node, b[i], sizeof (*t));
+	      t->sw_if_index = vnet_buffer (b[i])->sw_if_index[VLIB_RX];
+	      t->fib_index = fib_index[i];
+	      t->is_ip6 = (u8) is_ip6;
+	      t->is_ip2me = (u8) is_ip2me[i];
+	    }
 	}
 
-      b += 1;
-      next += 1;
-      n_left_from -= 1;
+      b += n;
+      next += n;
+      n_left_from -= n;
     }
 
   vlib_buffer_enqueue_to_next (vm, node, from, nexts, frame->n_vectors);
@@ -249,10 +351,7 @@ sonic_ext_ip2me_inline (vlib_main_t *vm, vlib_node_runtime_t *node,
   if (n_pass)
     vlib_node_increment_counter (vm, node->node_index,
 				 SONIC_EXT_IP2ME_ERROR_PASSTHRU, n_pass);
-  /* Best-effort summary for `show sonic-ext`; the per-thread HIT counter
-   * above is the authoritative count.  Non-atomic on purpose (a lost
-   * update under multi-worker only skews this debug total). */
-  sonic_ext_main.ip2me_hits += n_ip2me;
+  sonic_ext_counter_add (vm, SONIC_EXT_COUNTER_IP2ME_HITS, n_ip2me);
 
   return frame->n_vectors;
 }
@@ -16,7 +16,6 @@
 
 #include <vlib/vlib.h>
 #include <vnet/vnet.h>
-#include <vnet/interface.h>
 
 /*
  * sonic-ext-l2-trap-fixup
@@ -153,100 +152,132 @@ typedef enum
 } sonic_ext_l2_trap_fixup_next_t;
 
 /*
- * Resolve the parent physical sw_if_index for `rx_sw_if_index`:
- *   - SUB type sub-if  -> sup_sw_if_index (the parent phys)
- *   - everything else  -> rx_sw_if_index itself
- * Returns ~0 if rx is not a valid sw_if_index (shouldn't happen).
+ * Parent physical sw_if_index of rx_sw_if_index -- the sub-interface's
+ * sup_sw_if_index, or rx itself for a main interface -- from the flat
+ * sonic_ext_sw_parent table, so a trap storm on many VLAN sub-ports
+ * costs one bounds-checked load per packet rather than a pool check
+ * and an interface fetch.  ~0 if rx is not a valid sw_if_index
+ * (shouldn't happen).
  */
-static_always_inline u32
-sonic_ext_l2_trap_fixup_lookup_parent (vnet_main_t *vnm, u32 rx_sw_if_index)
+static_always_inline void
+sonic_ext_l2_trap_fixup_one (vlib_node_runtime_t *node, vlib_buffer_t *b,
+			     u32 rx, u16 *next, u32 *n_no_parent)
 {
-  vnet_sw_interface_t *swi;
+  u32 punt_rx = sonic_ext_sw_parent (rx);
 
-  if (PREDICT_FALSE (pool_is_free_index (vnm->interface_main.sw_interfaces,
-					 rx_sw_if_index)))
-    return ~0;
+  if (PREDICT_FALSE (punt_rx == ~0u))
+    {
+      *next = SONIC_EXT_L2_TRAP_FIXUP_NEXT_DROP;
+      b->error = node->errors[SONIC_EXT_L2_TRAP_FIXUP_ERROR_NO_PARENT];
+      *n_no_parent += 1;
+      return;
+    }
 
-  swi = vnet_get_sw_interface (vnm, rx_sw_if_index);
-  if (swi->type == VNET_SW_INTERFACE_TYPE_SUB)
-    return swi->sup_sw_if_index;
-  return rx_sw_if_index;
+  /*
+   * Substitute the parent phys for VLIB_RX so linux-cp-punt picks the
+   * parent's LCP pair (host tap) rather than a non-existent sub-if LCP
+   * pair.  linux-cp-punt rewinds to l2_hdr_offset, which restores the
+   * wire-format L2 header including any 802.1Q tag -- the kernel sees
+   * the original tagged frame on the parent's host tap and 8021q
+   * demuxes it to the Vlan netdev where the protocol's handler is
+   * listening.
+   */
+  vnet_buffer (b)->sw_if_index[VLIB_RX] = punt_rx;
+  *next = SONIC_EXT_L2_TRAP_FIXUP_NEXT_PUNT;
 }
 
 VLIB_NODE_FN (sonic_ext_l2_trap_fixup_node)
 (vlib_main_t *vm, vlib_node_runtime_t *node, vlib_frame_t *frame)
 {
-  vnet_main_t *vnm = vnet_get_main ();
-  u32 n_left, *from;
+  u32 n_left, *from, n_vectors = frame->n_vectors;
   vlib_buffer_t *bufs[VLIB_FRAME_SIZE], **b;
   u16 nexts[VLIB_FRAME_SIZE], *next;
-  u32 n_fixed_up = 0, n_no_parent = 0;
+  u32 rxs[VLIB_FRAME_SIZE];
+  u32 n_no_parent = 0, rx0, parent, same, i;
 
   from = vlib_frame_vector_args (frame);
-  n_left = frame->n_vectors;
-  vlib_get_buffers (vm, from, bufs, n_left);
-  b = bufs;
-  next = nexts;
+  vlib_get_buffers (vm, from, bufs, n_vectors);
 
-  while (n_left > 0)
+  /* Frame-level fast path: a storm arrives as frames from one port, so
+   * check whether every packet shares the first one's RX interface. */
+  rx0 = vnet_buffer (bufs[0])->sw_if_index[VLIB_RX];
+  same = 1;
+  for (i = 0; i < n_vectors; i++)
     {
-      u32 rx0 = vnet_buffer (b[0])->sw_if_index[VLIB_RX];
-      u32 punt_rx0 = sonic_ext_l2_trap_fixup_lookup_parent (vnm, rx0);
-      u8 dropped = 0;
+      rxs[i] = vnet_buffer (bufs[i])->sw_if_index[VLIB_RX];
+      same &= rxs[i] == rx0;
+    }
 
-      if (PREDICT_FALSE (punt_rx0 == ~0u))
-	{
-	  next[0] = SONIC_EXT_L2_TRAP_FIXUP_NEXT_DROP;
-	  b[0]->error =
-	    node->errors[SONIC_EXT_L2_TRAP_FIXUP_ERROR_NO_PARENT];
-	  n_no_parent++;
-	  dropped = 1;
-	  goto traced;
-	}
+  parent = sonic_ext_sw_parent (rx0);
+  if (same && parent != ~0u)
+    {
+      for (i = 0; i < n_vectors; i++)
+	vnet_buffer (bufs[i])->sw_if_index[VLIB_RX] = parent;
+      vlib_buffer_enqueue_to_single_next (
+	vm, node, from, SONIC_EXT_L2_TRAP_FIXUP_NEXT_PUNT, n_vectors);
+      goto trace;
+    }
 
-      /*
-       * Substitute the parent phys for VLIB_RX so linux-cp-punt
-       * picks the parent's LCP pair (host tap) rather than a
-       * non-existent sub-if LCP pair.  linux-cp-punt rewinds to
-       * l2_hdr_offset, which restores the wire-format L2 header
-       * including any 802.1Q tag — the kernel sees the original
-       * tagged frame on the parent's host tap and 8021q demuxes
-       * it to the Vlan netdev where the protocol's handler is
-       * listening.
-       */
-      vnet_buffer (b[0])->sw_if_index[VLIB_RX] = punt_rx0;
-      next[0] = SONIC_EXT_L2_TRAP_FIXUP_NEXT_PUNT;
-      n_fixed_up++;
+  b = bufs;
+  next = nexts;
+  n_left = n_vectors;
+  i = 0;
 
-    traced:
-      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE) &&
-			 (b[0]->flags & VLIB_BUFFER_IS_TRACED)))
-	{
-	  sonic_ext_l2_trap_fixup_trace_t *t =
-	    vlib_add_trace (vm, node, b[0], sizeof (*t));
-	  t->rx_sw_if_index = rx0;
-	  t->punt_rx_sw_if_index = punt_rx0;
-	  t->dropped = dropped;
-	}
+  while (n_left >= 4)
+    {
+      sonic_ext_l2_trap_fixup_one (node, b[0], rxs[i], next, &n_no_parent);
+      sonic_ext_l2_trap_fixup_one (node, b[1], rxs[i + 1], next + 1,
+				   &n_no_parent);
+      sonic_ext_l2_trap_fixup_one (node, b[2], rxs[i + 2], next + 2,
+				   &n_no_parent);
+      sonic_ext_l2_trap_fixup_one (node, b[3], rxs[i + 3], next + 3,
+				   &n_no_parent);
+      b += 4;
+      next += 4;
+      i += 4;
+      n_left -= 4;
+    }
 
+  while (n_left > 0)
+    {
+      sonic_ext_l2_trap_fixup_one (node, b[0], rxs[i], next, &n_no_parent);
       b += 1;
       next += 1;
+      i += 1;
       n_left -= 1;
     }
 
-  vlib_buffer_enqueue_to_next (vm, node, from, nexts, frame->n_vectors);
+  vlib_buffer_enqueue_to_next (vm, node, from, nexts, n_vectors);
+
+trace:
+  if (PREDICT_FALSE (node->flags & VLIB_NODE_FLAG_TRACE))
+    {
+      for (i = 0; i < n_vectors; i++)
+	{
+	  sonic_ext_l2_trap_fixup_trace_t *t;
+	  u32 punt_rx = sonic_ext_sw_parent (rxs[i]);
+
+	  if (!(bufs[i]->flags & VLIB_BUFFER_IS_TRACED))
+	    continue;
+	  t = vlib_add_trace (vm, node, bufs[i], sizeof (*t));
+	  t->rx_sw_if_index = rxs[i];
+	  t->punt_rx_sw_if_index = punt_rx;
+	  t->dropped = punt_rx == ~0u;
+	}
+    }
 
-  if (n_fixed_up)
+  if (n_vectors - n_no_parent)
     vlib_node_increment_counter (vm, sonic_ext_l2_trap_fixup_node.index,
 				 SONIC_EXT_L2_TRAP_FIXUP_ERROR_FIXED_UP,
-				 n_fixed_up);
+				 n_vectors - n_no_parent);
   if (n_no_parent)
     vlib_node_increment_counter (vm, sonic_ext_l2_trap_fixup_node.index,
 				 SONIC_EXT_L2_TRAP_FIXUP_ERROR_NO_PARENT,
 				 n_no_parent);
-  sonic_ext_main.l2_trap_fixups += n_fixed_up;
+  sonic_ext_counter_add (vm, SONIC_EXT_COUNTER_L2_TRAP_FIXUPS,
+			 n_vectors - n_no_parent);
 
-  return frame->n_vectors;
+  return n_vectors;
 }
 
 VLIB_REGISTER_NODE (sonic_ext_l2_trap_fixup_node) = {
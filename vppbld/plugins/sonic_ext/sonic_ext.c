@@ -21,9 +21,20 @@
 #include <vnet/l2/l2_input.h>
 #include <vnet/l2/l2_bvi.h>
 #include <vnet/l2/l2_in_out_feat_arc.h>
+#include <vnet/ip/ip4.h>
+#include <vnet/ip/ip6.h>
+#include <vnet/fib/ip4_fib.h>
+#include <vnet/fib/ip6_fib.h>
+#include <vnet/gso/gso.h>
+#include <vnet/devices/tap/tap.h>
 #include <vpp/app/version.h>
 #include <plugins/linux-cp/lcp_interface.h>
 
+#include <vppinfra/bihash_8_8.h>
+#include <vppinfra/bihash_template.c>
+#include <vppinfra/bihash_24_8.h>
+#include <vppinfra/bihash_template.c>
+
 sonic_ext_main_t sonic_ext_main;
 
 VLIB_PLUGIN_REGISTER () = {
@@ -75,11 +86,20 @@ sonic_ext_sw_is_sub (u32 sw_if_index)
 void
 sonic_ext_capture_enable_disable (u32 sw_if_index, int enable)
 {
+  sonic_ext_main_t *sem = &sonic_ext_main;
+
   if (sonic_ext_sw_is_sub (sw_if_index))
     return;
 
+  /* Idempotent: the on-demand resync calls this for every pair. */
+  enable = (enable != 0);
+  if (clib_bitmap_get (sem->capture_sw_if_indexes, sw_if_index) == enable)
+    return;
+
   vnet_feature_enable_disable ("device-input", "sonic-ext-capture",
 			       sw_if_index, enable, 0, 0);
+  sem->capture_sw_if_indexes =
+    clib_bitmap_set (sem->capture_sw_if_indexes, sw_if_index, enable);
 }
 
 void
@@ -100,6 +120,13 @@ sonic_ext_aggr_tap_redirect_enable_disable (u32 sw_if_index, int enable)
 			       enable, 0, 0);
 }
 
+void
+sonic_ext_copp_enable_disable (u32 sw_if_index, int enable)
+{
+  vnet_feature_enable_disable ("interface-output", "sonic-ext-copp",
+			       sw_if_index, enable, 0, 0);
+}
+
 /*
  * Enable / disable sonic-ext-glean-redirect on the ip4-drop / ip6-drop
  * arcs.  Those arcs are dispatched with sw_if_index 0 (ip_drop_or_punt
@@ -122,11 +149,7 @@ sonic_ext_redirect_to_ingress_tap (vlib_buffer_t *b, u32 orig_rx,
 				   u32 excluded_tap, u32 *host_tap,
 				   u16 *pushed_tpid, u16 *pushed_vlan_id)
 {
-  vnet_main_t *vnm = vnet_get_main ();
   sonic_ext_buffer_opaque_t *seb = sonic_ext_buffer (b);
-  vnet_sw_interface_t *swo;
-  const lcp_itf_pair_t *lip;
-  index_t lipi;
   u32 phy_sw;
   u32 saved_vlan_tag = seb->orig_vlan_tag;
   i32 adv;
@@ -135,25 +158,17 @@ sonic_ext_redirect_to_ingress_tap (vlib_buffer_t *b, u32 orig_rx,
   *pushed_tpid = 0;
   *pushed_vlan_id = 0;
 
-  swo = vnet_get_sw_interface_or_null (vnm, orig_rx);
-  if (!swo)
+  phy_sw = sonic_ext_sw_parent (orig_rx);
+  if (phy_sw == ~0)
     return 0;
 
-  if (swo->type == VNET_SW_INTERFACE_TYPE_SUB)
-    phy_sw = swo->sup_sw_if_index;
-  else
-    phy_sw = orig_rx;
-
-  lipi = lcp_itf_pair_find_by_phy (phy_sw);
-  if (lipi == INDEX_INVALID)
+  *host_tap = sonic_ext_phy_to_host (phy_sw);
+  if (*host_tap == ~0)
     return 0;
-
-  lip = lcp_itf_pair_get (lipi);
-  *host_tap = lip->lip_host_sw_if_index;
   if (*host_tap == excluded_tap)
     return 0;
 
-  seb->magic = 0;
+  seb->magic = SONIC_EXT_BUFFER_MAGIC_DONE;
 
   /* Restore the original wire L2 position.  ethernet-input may have
    * advanced past the Ethernet header before either redirect node runs. */
@@ -209,6 +224,92 @@ sonic_ext_ip2me_enable_disable (u32 sw_if_index, int enable)
 				  sw_if_index, enable, 0, 0);
 }
 
+/*
+ * ip2me local-address tables.  VPP gives no per-entry FIB add/delete
+ * notification, but most receive routes sonic-ext-ip2me meets are the
+ * ones VPP itself installs for interface addresses, so the interface
+ * address callbacks feed the fast path; the node's FIB lookup on a miss
+ * finds the rest.  Entries are refcounted: the same address on two
+ * interfaces of one table must survive the first delete.
+ */
+static void
+sonic_ext_ip2me_local4_add_del (u32 fib_index, const ip4_address_t *a,
+				int is_add)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  clib_bihash_kv_8_8_t kv, value;
+  int found;
+
+  sonic_ext_ip2me_key4 (&kv, fib_index, a);
+  found = !clib_bihash_search_8_8 (&sem->ip2me_local4, &kv, &value);
+
+  if (is_add)
+    {
+      kv.value = found ? value.value + 1 : 1;
+      clib_bihash_add_del_8_8 (&sem->ip2me_local4, &kv, 1);
+      sem->ip2me_n_local4 += !found;
+    }
+  else if (found && value.value > 1)
+    {
+      kv.value = value.value - 1;
+      clib_bihash_add_del_8_8 (&sem->ip2me_local4, &kv, 1);
+    }
+  else if (found)
+    {
+      clib_bihash_add_del_8_8 (&sem->ip2me_local4, &kv, 0);
+      sem->ip2me_n_local4 -= 1;
+    }
+}
+
+static void
+sonic_ext_ip2me_local6_add_del (u32 fib_index, const ip6_address_t *a,
+				int is_add)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  clib_bihash_kv_24_8_t kv, value;
+  int found;
+
+  sonic_ext_ip2me_key6 (&kv, fib_index, a);
+  found = !clib_bihash_search_24_8 (&sem->ip2me_local6, &kv, &value);
+
+  if (is_add)
+    {
+      kv.value = found ? value.value + 1 : 1;
+      clib_bihash_add_del_24_8 (&sem->ip2me_local6, &kv, 1);
+      sem->ip2me_n_local6 += !found;
+    }
+  else if (found && value.value > 1)
+    {
+      kv.value = value.value - 1;
+      clib_bihash_add_del_24_8 (&sem->ip2me_local6, &kv, 1);
+    }
+  else if (found)
+    {
+      clib_bihash_add_del_24_8 (&sem->ip2me_local6, &kv, 0);
+      sem->ip2me_n_local6 -= 1;
+    }
+}
+
+static void
+sonic_ext_ip4_address_add_del_cb (ip4_main_t *im, uword opaque,
+				  u32 sw_if_index, ip4_address_t *address,
+				  u32 address_length, u32 if_address_index,
+				  u32 is_del)
+{
+  sonic_ext_ip2me_local4_add_del (
+    ip4_fib_table_get_index_for_sw_if_index (sw_if_index), address, !is_del);
+}
+
+static void
+sonic_ext_ip6_address_add_del_cb (ip6_main_t *im, uword opaque,
+				  u32 sw_if_index, ip6_address_t *address,
+				  u32 address_length, u32 if_address_index,
+				  u32 is_del)
+{
+  sonic_ext_ip2me_local6_add_del (
+    ip6_fib_table_get_index_for_sw_if_index (sw_if_index), address, !is_del);
+}
+
 /*
  * Is `phy_sw_if_index` a BVI (bridge-virtual interface)?  Used by
  * the aggregate-detection helper.  Distinct from is_aggregate so
@@ -306,43 +407,268 @@ sonic_ext_host_xc_walk_enable_cb (index_t lipi, void *ctx)
 }
 
 /*
- * lcp_itf_pair_walk callback: enable sonic-ext-capture on this pair's
- * phy if (and only if) the phy is a real wire port -- i.e. NOT an
- * "aggregate" pseudo-phy (BVI / bond master).  Capture's job is to
- * stamp the original wire-ingress sw_if_index + VLAN tag into the
- * buffer cookie before any L2 bridging mangles VLIB_RX, so it must
- * fire on the actual member port, not on synthetic interfaces.
+ * On-demand capture.
+ *
+ * The capture cookie is only ever consumed when a packet later punts
+ * through the host tap of an aggregate (BVI / bond), i.e. when it
+ * arrived on a port that can feed one: a bond member, or a port whose
+ * main interface or one of its sub-interfaces is bridged into a bridge
+ * domain that has a BVI.  In on-demand mode capture is enabled on those
+ * ports only, so pure routed ports never pay the device-input hop.
  *
- * Sub-interfaces share their parent's device-input dispatch -- we
- * never enable on the sub directly, only on the parent phy.
+ * Bond membership changes are seen through the feature update callback
+ * (bond enslave / release toggles bond-input on the member's
+ * device-input arc), and LCP pair adds and interface deletes kick the
+ * sync process too.  Bridge membership -- from the API, the CLI or a
+ * BVI coming or going -- has no notification hook, so while on-demand
+ * mode is on the sync process also rescans the L2 input configs on a
+ * slow timer.  The rescan is read-only; the LCP pairs are only walked
+ * when the set of BVI feeders changed, and the worker barrier only
+ * taken when a phy's capture state has to change.
+ */
+#define SONIC_EXT_CAPTURE_SYNC_INTERVAL 1.0
+
+typedef enum
+{
+  SONIC_EXT_CAPTURE_SYNC_EVENT_KICK = 1,
+} sonic_ext_capture_sync_event_t;
+
+/* Bitmap of main sw_if_indexes that have themselves, or through a
+ * sub-interface, a port in a BVI bridge domain.  Caller frees. */
+static uword *
+sonic_ext_capture_bvi_feeders (void)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  l2input_main_t *l2im = &l2input_main;
+  l2_input_config_t *cfg;
+  l2_bridge_domain_t *bd;
+  vnet_sw_interface_t *swi;
+  uword *feeders = 0;
+  u32 sw_if_index;
+
+  vec_foreach_index (sw_if_index, l2im->configs)
+    {
+      cfg = vec_elt_at_index (l2im->configs, sw_if_index);
+      if (!l2_input_is_bridge (cfg) || l2_input_is_bvi (cfg))
+	continue;
+      if (cfg->bd_index >= vec_len (l2im->bd_configs))
+	continue;
+      bd = l2input_bd_config (cfg->bd_index);
+      if (bd->bvi_sw_if_index == ~0)
+	continue;
+      swi = vnet_get_sw_interface_or_null (vnm, sw_if_index);
+      if (swi)
+	feeders = clib_bitmap_set (feeders, swi->sup_sw_if_index, 1);
+    }
+
+  return feeders;
+}
+
+/*
+ * Should sonic-ext-capture run on this pair's phy?  Never on an
+ * "aggregate" pseudo-phy (BVI / bond master): capture's job is to
+ * stamp the original wire-ingress sw_if_index + VLAN tag into the
+ * buffer cookie before any L2 bridging mangles VLIB_RX, so it must fire
+ * on the actual member port, not on synthetic interfaces.  In on-demand
+ * mode, additionally only on ports that can feed an aggregate.
+ */
+static int
+sonic_ext_capture_wanted (u32 phy_sw_if_index, uword *bvi_feeders)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  vnet_hw_interface_t *hw;
+
+  if (sonic_ext_phy_is_aggregate (phy_sw_if_index))
+    return 0;
+  if (!sem->capture_on_demand)
+    return 1;
+  if (clib_bitmap_get (bvi_feeders, phy_sw_if_index))
+    return 1;
+
+  hw = vnet_get_sup_hw_interface_api_visible_or_null (vnet_get_main (),
+						      phy_sw_if_index);
+  return hw && hw->bond_info == VNET_HW_INTERFACE_BOND_INFO_SLAVE;
+}
+
+typedef struct
+{
+  uword *bvi_feeders;
+  u32 n_changes;
+  u8 apply;
+} sonic_ext_capture_sync_ctx_t;
+
+/*
+ * lcp_itf_pair_walk callback: bring capture on this pair's phy in line
+ * with sonic_ext_capture_wanted.  Sub-interfaces share their parent's
+ * device-input dispatch -- we never enable on the sub directly, only
+ * on the parent phy.
  */
 static walk_rc_t
-sonic_ext_capture_walk_enable_cb (index_t lipi, void *ctx)
+sonic_ext_capture_sync_walk_cb (index_t lipi, void *arg)
 {
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  sonic_ext_capture_sync_ctx_t *ctx = arg;
   const lcp_itf_pair_t *lip = lcp_itf_pair_get (lipi);
-  if (lip && !sonic_ext_phy_is_aggregate (lip->lip_phy_sw_if_index))
-    sonic_ext_capture_enable_disable (lip->lip_phy_sw_if_index, 1);
+  u32 phy;
+  int want;
+
+  if (!lip)
+    return WALK_CONTINUE;
+
+  phy = lip->lip_phy_sw_if_index;
+  if (sonic_ext_sw_is_sub (phy))
+    return WALK_CONTINUE;
+
+  want = sonic_ext_capture_wanted (phy, ctx->bvi_feeders);
+  if (clib_bitmap_get (sem->capture_sw_if_indexes, phy) == want)
+    return WALK_CONTINUE;
+
+  ctx->n_changes++;
+  if (ctx->apply)
+    sonic_ext_capture_enable_disable (phy, want);
   return WALK_CONTINUE;
 }
 
+/*
+ * Walk every LCP pair and count the phys whose capture state is out of
+ * sync; with `apply` set, also fix them up.  Feature changes need the
+ * worker barrier, which the callers already hold or take.
+ */
+static u32
+sonic_ext_capture_sync (int apply)
+{
+  sonic_ext_capture_sync_ctx_t ctx = {
+    .apply = apply,
+  };
+
+  if (sonic_ext_main.capture_on_demand)
+    ctx.bvi_feeders = sonic_ext_capture_bvi_feeders ();
+  lcp_itf_pair_walk (sonic_ext_capture_sync_walk_cb, &ctx);
+  clib_bitmap_free (ctx.bvi_feeders);
+
+  return ctx.n_changes;
+}
+
+static uword
+sonic_ext_capture_sync_process (vlib_main_t *vm, vlib_node_runtime_t *rt,
+				vlib_frame_t *f)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  uword *event_data = 0, *feeders = 0, *last_feeders = 0;
+  int kicked, changed;
+
+  while (1)
+    {
+      if (sem->capture_on_demand)
+	vlib_process_wait_for_event_or_clock (vm,
+					      SONIC_EXT_CAPTURE_SYNC_INTERVAL);
+      else
+	vlib_process_wait_for_event (vm);
+
+      kicked = vlib_process_get_events (vm, &event_data) != ~0;
+      vec_reset_length (event_data);
+
+      if (!sem->capture_on_demand || !sem->capture_enabled)
+	continue;
+
+      feeders = sonic_ext_capture_bvi_feeders ();
+      changed = !clib_bitmap_is_equal (feeders, last_feeders);
+      clib_bitmap_free (last_feeders);
+      last_feeders = feeders;
+
+      if (!kicked && !changed)
+	continue;
+      if (!sonic_ext_capture_sync (0))
+	continue;
+
+      vlib_worker_thread_barrier_sync (vm);
+      sonic_ext_capture_sync (1);
+      vlib_worker_thread_barrier_release (vm);
+    }
+
+  return 0;
+}
+
+VLIB_REGISTER_NODE (sonic_ext_capture_sync_node) = {
+  .function = sonic_ext_capture_sync_process,
+  .type = VLIB_NODE_TYPE_PROCESS,
+  .name = "sonic-ext-capture-sync",
+};
+
+static void
+sonic_ext_capture_sync_kick (void)
+{
+  if (!sonic_ext_main.capture_on_demand)
+    return;
+
+  vlib_process_signal_event (vlib_get_main (),
+			     sonic_ext_capture_sync_node.index,
+			     SONIC_EXT_CAPTURE_SYNC_EVENT_KICK, 0);
+}
+
+/*
+ * Feature update callback.  Bond enslave / release toggles bond-input
+ * on the member's device-input arc; that is our cue that a port became
+ * (or stopped being) a bond member.  We cannot toggle features from
+ * inside the callback, so just kick the sync process.
+ */
+static void
+sonic_ext_feature_update_cb (u32 sw_if_index, u8 arc_index, u8 is_enable,
+			     void *data)
+{
+  if (arc_index == feature_main.device_input_feature_arc_index)
+    sonic_ext_capture_sync_kick ();
+}
+
+void
+sonic_ext_set_capture_on_demand (u8 on_demand)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+
+  sem->capture_on_demand = (on_demand != 0);
+  if (sem->capture_enabled)
+    sonic_ext_capture_sync (1);
+
+  /* Wake the sync process so it (re)arms or drops its timer. */
+  vlib_process_signal_event (vlib_get_main (),
+			     sonic_ext_capture_sync_node.index,
+			     SONIC_EXT_CAPTURE_SYNC_EVENT_KICK, 0);
+}
+
+/*
+ * punt-via-member and host-xc are wired once -- capture, glean-redirect
+ * and the host taps' host-xc feature stay enabled from then on -- and
+ * turning either off or back on is only the flag their nodes test per
+ * frame.  A plain store is enough for that: a worker sees the new value
+ * at its next frame at the latest, and no packet depends on seeing it
+ * earlier.  The CLI / API for these toggles is therefore mp-safe, and
+ * only the one-time wiring below takes the worker barrier (it nests if
+ * the caller already holds it).
+ */
 void
 sonic_ext_set_punt_via_member (u8 is_enable)
 {
   sonic_ext_main_t *sem = &sonic_ext_main;
+  vlib_main_t *vm = vlib_get_main ();
 
   sem->punt_via_member = (is_enable != 0);
+  if (!is_enable || (sem->capture_enabled && sem->glean_redirect_enabled))
+    return;
+
+  vlib_worker_thread_barrier_sync (vm);
 
   /* Capture only fires on the wire phy side of LCP pairs (real ports,
    * not BVIs/bonds) so the original ingress sw_if_index + VLAN tag is
-   * recorded before L2 bridging overwrites VLIB_RX with the BVI.  We
+   * recorded before L2 bridging overwrites VLIB_RX with the BVI -- and
+   * in on-demand mode only on the ports that can feed one.  We
    * leave the capture feature enabled even after disabling
    * punt-via-member to avoid the per-interface enable/disable churn
    * (the downstream redirect node short-circuits via the cookie magic
    * check when the toggle is off). */
-  if (is_enable && !sem->capture_enabled)
+  if (!sem->capture_enabled)
     {
-      lcp_itf_pair_walk (sonic_ext_capture_walk_enable_cb, NULL);
       sem->capture_enabled = 1;
+      sonic_ext_capture_sync (1);
     }
 
   /* Glean-redirect is a single global feature on the ip4/ip6-drop
@@ -350,7 +676,7 @@ sonic_ext_set_punt_via_member (u8 is_enable)
    * self-scopes via the capture cookie + glean/arp adjacency check
    * and short-circuits when punt_via_member is off, so we never need
    * to disable it per-interface. */
-  if (is_enable && !sem->glean_redirect_enabled)
+  if (!sem->glean_redirect_enabled)
     {
       sonic_ext_glean_redirect_enable_disable (1);
       sem->glean_redirect_enabled = 1;
@@ -360,12 +686,14 @@ sonic_ext_set_punt_via_member (u8 is_enable)
    * the LCP pair add/del callback (sonic_ext_lcp_pair_add_cb) -- it
    * only needs to fire on the host tap of BVI/bond masters, never on
    * every phy.  No per-interface iteration here. */
+  vlib_worker_thread_barrier_release (vm);
 }
 
 void
 sonic_ext_set_host_xc (u8 is_enable)
 {
   sonic_ext_main_t *sem = &sonic_ext_main;
+  vlib_main_t *vm = vlib_get_main ();
 
   sem->host_xc = (is_enable != 0);
 
@@ -378,20 +706,320 @@ sonic_ext_set_host_xc (u8 is_enable)
    * costs a feature-arc dispatch per packet. */
   if (is_enable && !sem->host_xc_enabled)
     {
+      vlib_worker_thread_barrier_sync (vm);
       lcp_itf_pair_walk (sonic_ext_host_xc_walk_enable_cb, NULL);
       sem->host_xc_enabled = 1;
+      vlib_worker_thread_barrier_release (vm);
     }
 }
 
+void
+sonic_ext_set_host_xc_direct_tx (u8 is_enable)
+{
+  /* The per-phy TX next indices are kept up to date from the LCP pair
+   * callbacks regardless, so this is just the fast-path switch. */
+  sonic_ext_main.host_xc_direct_tx = (is_enable != 0);
+}
+
+/*
+ * Bulk linux-cp pair create / delete.  Each lcp create from the CLI is
+ * its own barrier sync, tap create and pair-add callback round, and
+ * the hostif script used to pace them with a sleep; a cold start of a
+ * 64-port box spent minutes there.  Here all pairs go in under one
+ * barrier.  The host tap takes its MAC and MTU from the phy in the tap
+ * create request itself (lcp_itf_pair_create), so there is no separate
+ * netlink round per setting.
+ *
+ * Queue count comes from the linux-cp startup config (num-rx-queues /
+ * num-tx-queues); with one queue per thread the tap's RX queues are
+ * spread over the workers and every thread owns a TX queue.  GSO lets
+ * the kernel hand over (and take) 64k TCP super-frames instead of
+ * segmenting them; a phy that cannot segment in hardware gets VPP's
+ * gso feature so host-xc'd super-frames are still cut to the wire MTU.
+ */
+static int
+sonic_ext_lcp_pair_offload (vlib_main_t *vm, sonic_ext_lcp_pair_req_t *req,
+			    u32 flags)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  vnet_hw_interface_t *hi;
+  int rv;
+
+  rv = tap_gso_enable_disable (vm, req->host_sw_if_index, 1,
+			       (flags & SONIC_EXT_LCP_F_GRO) != 0);
+  if (rv)
+    return rv;
+
+  hi = vnet_get_sup_hw_interface (vnm, req->phy_sw_if_index);
+  if (!(hi->caps & VNET_HW_IF_CAP_TCP_GSO))
+    rv = vnet_sw_interface_gso_enable_disable (req->phy_sw_if_index, 1);
+
+  return rv;
+}
+
+int
+sonic_ext_lcp_pairs_add_del (sonic_ext_lcp_pair_req_t *reqs, int is_add,
+			     u32 flags)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  vlib_main_t *vm = vlib_get_main ();
+  sonic_ext_lcp_pair_req_t *req;
+  int rv = 0;
+
+  vlib_worker_thread_barrier_sync (vm);
+
+  vec_foreach (req, reqs)
+    {
+      req->host_sw_if_index = ~0;
+      if (!vnet_sw_interface_is_valid (vnm, req->phy_sw_if_index))
+	req->rv = VNET_API_ERROR_INVALID_SW_IF_INDEX;
+      else if (is_add)
+	{
+	  req->rv = lcp_itf_pair_create (req->phy_sw_if_index,
+					 req->host_if_name, LCP_ITF_HOST_TAP,
+					 NULL, &req->host_sw_if_index);
+	  if (!req->rv && flags)
+	    req->rv = sonic_ext_lcp_pair_offload (vm, req, flags);
+	}
+      else
+	req->rv = lcp_itf_pair_delete (req->phy_sw_if_index);
+
+      if (req->rv && !rv)
+	rv = req->rv;
+    }
+
+  vlib_worker_thread_barrier_release (vm);
+  return rv;
+}
+
+static walk_rc_t
+sonic_ext_copp_walk_cb (index_t lipi, void *ctx)
+{
+  const lcp_itf_pair_t *lip = lcp_itf_pair_get (lipi);
+  if (lip)
+    sonic_ext_copp_enable_disable (lip->lip_host_sw_if_index,
+				   pointer_to_uword (ctx));
+  return WALK_CONTINUE;
+}
+
+/*
+ * sonic-ext-copp carries CoPP, priority punt and the tap-tx latency
+ * exit, so it sits on the host taps while any of them is on.  Unlike
+ * capture / host-xc it is really taken off again: with all of them off
+ * there should be no extra hop on the punt path at all.
+ */
+static void
+sonic_ext_copp_feature_sync (void)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  u8 want = sem->copp_enabled || sem->punt_prio || sem->latency_enabled;
+
+  if (want == sem->copp_feature_on)
+    return;
+
+  lcp_itf_pair_walk (sonic_ext_copp_walk_cb, uword_to_pointer (want, void *));
+  sem->copp_feature_on = want;
+}
+
+void
+sonic_ext_set_copp (u8 is_enable)
+{
+  sonic_ext_main.copp_enabled = (is_enable != 0);
+  sonic_ext_copp_feature_sync ();
+}
+
+void
+sonic_ext_set_punt_prio (u8 is_enable)
+{
+  sonic_ext_main.punt_prio = (is_enable != 0);
+  sonic_ext_copp_feature_sync ();
+}
+
+void
+sonic_ext_set_punt_latency (u8 is_enable)
+{
+  sonic_ext_main.latency_enabled = (is_enable != 0);
+  sonic_ext_copp_feature_sync ();
+}
+
+void
+sonic_ext_punt_latency_clear (void)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  u32 e, i;
+
+  for (e = 0; e < SONIC_EXT_LATENCY_N_EXITS; e++)
+    for (i = 0; i < SONIC_EXT_LATENCY_N_BINS; i++)
+      vlib_zero_simple_counter (&sem->latency[e], i);
+}
+
+int
+sonic_ext_punt_queue_set_class (sonic_ext_copp_class_t c, u16 queue,
+				u8 priority, u32 frame_limit)
+{
+  sonic_ext_punt_queue_cfg_t *qc;
+
+  if (c >= SONIC_EXT_COPP_N_CLASSES || priority >= SONIC_EXT_PUNT_N_PRIOS)
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  qc = &sonic_ext_main.punt_queues[c];
+  qc->queue = queue;
+  qc->priority = priority;
+  qc->frame_limit = frame_limit;
+  return 0;
+}
+
+/*
+ * Default priority punt layout: link and routing protocol keepalives
+ * first, then address resolution / DHCP, then everything else.  The
+ * queue follows the priority, so on a 4-queue tap each level gets its
+ * own ring.
+ */
+static void
+sonic_ext_punt_queue_defaults (void)
+{
+  static const u8 prio[SONIC_EXT_COPP_N_CLASSES] = {
+    [SONIC_EXT_COPP_CLASS_LACP] = 0,
+    [SONIC_EXT_COPP_CLASS_BGP] = 0,
+    [SONIC_EXT_COPP_CLASS_LLDP] = 1,
+    [SONIC_EXT_COPP_CLASS_ARP] = 1,
+    [SONIC_EXT_COPP_CLASS_ND] = 1,
+    [SONIC_EXT_COPP_CLASS_DHCP] = 2,
+    [SONIC_EXT_COPP_CLASS_IP2ME] = 2,
+    [SONIC_EXT_COPP_CLASS_TTL_EXPIRY] = 3,
+    [SONIC_EXT_COPP_CLASS_OTHER] = 3,
+  };
+  u32 c;
+
+  for (c = 0; c < SONIC_EXT_COPP_N_CLASSES; c++)
+    sonic_ext_punt_queue_set_class (c, prio[c], prio[c], 0);
+}
+
+/*
+ * Refill a class's bucket so a changed rate or burst takes effect at
+ * once.  The bucket is shared by all threads, see sonic-ext-copp.
+ */
+static void
+sonic_ext_copp_update_class (sonic_ext_copp_class_t c)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+
+  clib_atomic_store_rel_n (&sem->copp_buckets[c].full_at, 0);
+}
+
+int
+sonic_ext_copp_set_class (sonic_ext_copp_class_t c, u32 rate_pps, u32 burst)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+
+  if (c >= SONIC_EXT_COPP_N_CLASSES)
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  sem->copp_classes[c].rate_pps = rate_pps;
+  sem->copp_classes[c].burst = burst ? burst : rate_pps;
+  sonic_ext_copp_update_class (c);
+  return 0;
+}
+
+/*
+ * Only the global glean budget is split over the threads, each
+ * enforcing rate / n_threads of it, since it bounds the total punt
+ * load.  An ingress port's RX queues are normally polled by one worker,
+ * so splitting its budget would hold that port to a fraction of its
+ * configured rate.  Each thread therefore enforces the full port rate;
+ * a port spread over several workers can exceed it, and the global
+ * budget still bounds the total.  Both buckets hold one second's worth
+ * of burst, and all are refilled so a tightened limit takes effect at
+ * once.
+ */
+static void
+sonic_ext_glean_update_limits (void)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  sonic_ext_glean_per_thread_t *pt;
+  sonic_ext_glean_bucket_t *bk;
+  u32 n_threads = clib_max (vlib_get_n_threads (), 1);
+
+  sem->glean_thread_global_rate = (f64) sem->glean_global_rate / n_threads;
+
+  vec_foreach (pt, sem->glean_per_thread)
+    {
+      pt->global.tokens = clib_max (sem->glean_thread_global_rate, 1.0);
+      pt->global.last = 0;
+      vec_foreach (bk, pt->by_if)
+	{
+	  bk->tokens = clib_max (sem->glean_if_rate, 1);
+	  bk->last = 0;
+	}
+    }
+}
+
+int
+sonic_ext_set_glean_limits (u32 window_usec, u32 if_rate_pps,
+			    u32 global_rate_pps)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+
+  if (window_usec == 0)
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  sem->glean_window = window_usec * 1e-6;
+  sem->glean_if_rate = if_rate_pps;
+  sem->glean_global_rate = global_rate_pps;
+
+  /* Before main-loop enter the throttle does not exist yet; it is
+   * created with glean_window then. */
+  if (sem->glean_throttle.bitmaps)
+    sem->glean_throttle.time = sem->glean_window;
+  sonic_ext_glean_update_limits ();
+  return 0;
+}
+
+u8 *
+format_sonic_ext_copp_class (u8 *s, va_list *args)
+{
+  u32 c = va_arg (*args, u32);
+
+  switch (c)
+    {
+#define _(sym, str)                                                           \
+  case SONIC_EXT_COPP_CLASS_##sym:                                            \
+    return format (s, str);
+      foreach_sonic_ext_copp_class
+#undef _
+    }
+  return format (s, "unknown-%u", c);
+}
+
+uword
+unformat_sonic_ext_copp_class (unformat_input_t *input, va_list *args)
+{
+  sonic_ext_copp_class_t *c = va_arg (*args, sonic_ext_copp_class_t *);
+
+  if (0)
+    ;
+#define _(sym, str)                                                           \
+  else if (unformat (input, str))                                             \
+    *c = SONIC_EXT_COPP_CLASS_##sym;
+  foreach_sonic_ext_copp_class
+#undef _
+  else
+    return 0;
+  return 1;
+}
+
 /*
  * LCP pair add/del: when a new linux-cp pair appears, enable the per-
  * interface sonic-ext features that apply.
  *
  *   - sonic-ext-capture on the phy   -- only if phy is a real wire
- *     port (not BVI / bond master) and punt-via-member is enabled.
+ *     port (not BVI / bond master) and punt-via-member is enabled;
+ *     in on-demand mode also only if it can feed an aggregate.
  *   - sonic-ext-host-xc on the host  -- only if host-xc is enabled.
  *   - sonic-ext-aggr-tap-redirect on the host  -- only if phy is an
  *     aggregate (BVI today, bond tomorrow) and punt-via-member is on.
+ *   - sonic-ext-copp on the host  -- only if CoPP or priority punt
+ *     is enabled.
  *
  * DHCPv4 client broadcast is trapped at l2-input-classify by the
  * per-member classifier session installed in SwitchVppFdb.cpp; it
@@ -405,13 +1033,53 @@ static void
 sonic_ext_lcp_pair_add_cb (lcp_itf_pair_t *lip)
 {
   sonic_ext_main_t *sem = &sonic_ext_main;
+
   if (!lip)
     return;
-  if (sem->capture_enabled
-      && !sonic_ext_phy_is_aggregate (lip->lip_phy_sw_if_index))
-    sonic_ext_capture_enable_disable (lip->lip_phy_sw_if_index, 1);
+
+  vec_validate_init_empty (sem->phy_by_host, lip->lip_host_sw_if_index, ~0);
+  vec_validate_init_empty (sem->host_by_phy, lip->lip_phy_sw_if_index, ~0);
+  sem->phy_by_host[lip->lip_host_sw_if_index] = lip->lip_phy_sw_if_index;
+  sem->host_by_phy[lip->lip_phy_sw_if_index] = lip->lip_host_sw_if_index;
+
+  if (!sonic_ext_sw_is_sub (lip->lip_host_sw_if_index))
+    {
+      vnet_hw_interface_t *hi = vnet_get_sup_hw_interface (
+	vnet_get_main (), lip->lip_host_sw_if_index);
+
+      vec_validate_init_empty (sem->tx_next_by_host,
+			       lip->lip_host_sw_if_index, ~0);
+      sem->tx_next_by_host[lip->lip_host_sw_if_index] = vlib_node_add_next (
+	vlib_get_main (), sonic_ext_copp_node.index, hi->tx_node_index);
+    }
+
+  /* Only a main interface owns a TX node; a sub-interface's host tap
+   * never feeds host-xc anyway (see sonic_ext_sw_is_sub). */
+  if (!sonic_ext_sw_is_sub (lip->lip_phy_sw_if_index))
+    {
+      vnet_hw_interface_t *hi =
+	vnet_get_sup_hw_interface (vnet_get_main (), lip->lip_phy_sw_if_index);
+
+      vec_validate_init_empty (sem->tx_next_by_phy, lip->lip_phy_sw_if_index,
+			       ~0);
+      sem->tx_next_by_phy[lip->lip_phy_sw_if_index] = vlib_node_add_next (
+	vlib_get_main (), sonic_ext_host_xc_node.index, hi->tx_node_index);
+    }
+
+  /* In on-demand mode whether this phy feeds a BVI takes a scan of the
+   * L2 configs; leave that to the sync process, once for a whole bulk
+   * create rather than once per pair. */
+  if (sem->capture_enabled)
+    {
+      if (sem->capture_on_demand)
+	sonic_ext_capture_sync_kick ();
+      else if (sonic_ext_capture_wanted (lip->lip_phy_sw_if_index, 0))
+	sonic_ext_capture_enable_disable (lip->lip_phy_sw_if_index, 1);
+    }
   if (sem->host_xc_enabled)
     sonic_ext_host_xc_enable_disable (lip->lip_host_sw_if_index, 1);
+  if (sem->copp_feature_on)
+    sonic_ext_copp_enable_disable (lip->lip_host_sw_if_index, 1);
   if (sonic_ext_phy_is_aggregate (lip->lip_phy_sw_if_index))
     sonic_ext_aggr_tap_redirect_enable_disable (lip->lip_host_sw_if_index, 1);
 }
@@ -422,15 +1090,147 @@ sonic_ext_lcp_pair_del_cb (lcp_itf_pair_t *lip)
   sonic_ext_main_t *sem = &sonic_ext_main;
   if (!lip)
     return;
-  if (sem->capture_enabled
-      && !sonic_ext_phy_is_aggregate (lip->lip_phy_sw_if_index))
-    sonic_ext_capture_enable_disable (lip->lip_phy_sw_if_index, 0);
+
+  if (lip->lip_host_sw_if_index < vec_len (sem->phy_by_host))
+    sem->phy_by_host[lip->lip_host_sw_if_index] = ~0;
+  if (lip->lip_phy_sw_if_index < vec_len (sem->host_by_phy))
+    sem->host_by_phy[lip->lip_phy_sw_if_index] = ~0;
+  if (lip->lip_phy_sw_if_index < vec_len (sem->tx_next_by_phy))
+    sem->tx_next_by_phy[lip->lip_phy_sw_if_index] = ~0;
+  if (lip->lip_host_sw_if_index < vec_len (sem->tx_next_by_host))
+    sem->tx_next_by_host[lip->lip_host_sw_if_index] = ~0;
+
+  /* No-op unless capture is actually on for this phy. */
+  sonic_ext_capture_enable_disable (lip->lip_phy_sw_if_index, 0);
   if (sem->host_xc_enabled)
     sonic_ext_host_xc_enable_disable (lip->lip_host_sw_if_index, 0);
+  if (sem->copp_feature_on)
+    sonic_ext_copp_enable_disable (lip->lip_host_sw_if_index, 0);
   if (sonic_ext_phy_is_aggregate (lip->lip_phy_sw_if_index))
     sonic_ext_aggr_tap_redirect_enable_disable (lip->lip_host_sw_if_index, 0);
 }
 
+/* Size and zero the per-interface counters for sw_if_index, and give
+ * it a full glean budget bucket on every thread. */
+static void
+sonic_ext_if_counters_validate (u32 sw_if_index)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  sonic_ext_glean_per_thread_t *pt;
+
+  vlib_validate_simple_counter (&sem->if_punt_redirects, sw_if_index);
+  vlib_zero_simple_counter (&sem->if_punt_redirects, sw_if_index);
+  vlib_validate_simple_counter (&sem->if_host_xc, sw_if_index);
+  vlib_zero_simple_counter (&sem->if_host_xc, sw_if_index);
+  vlib_validate_simple_counter (&sem->if_glean_throttled, sw_if_index);
+  vlib_zero_simple_counter (&sem->if_glean_throttled, sw_if_index);
+
+  vec_foreach (pt, sem->glean_per_thread)
+    {
+      vec_validate (pt->by_if, sw_if_index);
+      pt->by_if[sw_if_index].tokens = clib_max (sem->glean_if_rate, 1);
+      pt->by_if[sw_if_index].last = 0;
+    }
+}
+
+/*
+ * Keep parent_by_sw in step with the interface pool.  A main interface
+ * maps to itself (sup_sw_if_index == sw_if_index), a sub-interface to
+ * its parent.
+ */
+static clib_error_t *
+sonic_ext_sw_interface_add_del (vnet_main_t *vnm, u32 sw_if_index,
+				u32 is_add)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  vnet_sw_interface_t *swi;
+
+  vec_validate_init_empty (sem->parent_by_sw, sw_if_index, ~0);
+  if (is_add)
+    {
+      swi = vnet_get_sw_interface (vnm, sw_if_index);
+      sem->parent_by_sw[sw_if_index] = swi->sup_sw_if_index;
+    }
+  else
+    sem->parent_by_sw[sw_if_index] = ~0;
+
+  if (sem->if_counters_ready)
+    sonic_ext_if_counters_validate (sw_if_index);
+
+  /* A deleted BVI takes its bridge domain's members with it */
+  if (!is_add)
+    sonic_ext_capture_sync_kick ();
+
+  return 0;
+}
+
+VNET_SW_INTERFACE_ADD_DEL_FUNCTION (sonic_ext_sw_interface_add_del);
+
+/*
+ * Name and size the stats-segment counters.  A simple counter keeps a
+ * vector per vlib_main, sized from the thread configuration that is
+ * already known at init, so worker threads need not have been started.
+ */
+static void
+sonic_ext_counters_init (void)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  u32 i;
+
+  sem->counters.name = "sonic-ext";
+  sem->counters.stat_segment_name = "/sonic-ext/summary";
+  vlib_validate_simple_counter (&sem->counters, SONIC_EXT_N_COUNTERS - 1);
+  for (i = 0; i < SONIC_EXT_N_COUNTERS; i++)
+    vlib_zero_simple_counter (&sem->counters, i);
+
+  sem->if_punt_redirects.name = "punt-redirects";
+  sem->if_punt_redirects.stat_segment_name = "/sonic-ext/if/punt-redirects";
+  sem->if_host_xc.name = "host-xc";
+  sem->if_host_xc.stat_segment_name = "/sonic-ext/if/host-xc";
+  sem->if_glean_throttled.name = "glean-throttled";
+  sem->if_glean_throttled.stat_segment_name = "/sonic-ext/if/glean-throttled";
+  sem->if_counters_ready = 1;
+
+  sem->copp_passed.name = "copp-passed";
+  sem->copp_passed.stat_segment_name = "/sonic-ext/copp/passed";
+  sem->copp_dropped.name = "copp-dropped";
+  sem->copp_dropped.stat_segment_name = "/sonic-ext/copp/dropped";
+  vlib_validate_simple_counter (&sem->copp_passed,
+				SONIC_EXT_COPP_N_CLASSES - 1);
+  vlib_validate_simple_counter (&sem->copp_dropped,
+				SONIC_EXT_COPP_N_CLASSES - 1);
+  for (i = 0; i < SONIC_EXT_COPP_N_CLASSES; i++)
+    {
+      vlib_zero_simple_counter (&sem->copp_passed, i);
+      vlib_zero_simple_counter (&sem->copp_dropped, i);
+    }
+
+  sem->punt_queue_steered.name = "punt-queue-steered";
+  sem->punt_queue_steered.stat_segment_name = "/sonic-ext/punt-queue/steered";
+  sem->punt_queue_limit_drops.name = "punt-queue-limit-drops";
+  sem->punt_queue_limit_drops.stat_segment_name =
+    "/sonic-ext/punt-queue/frame-limit-drops";
+  vlib_validate_simple_counter (&sem->punt_queue_steered,
+				SONIC_EXT_COPP_N_CLASSES - 1);
+  vlib_validate_simple_counter (&sem->punt_queue_limit_drops,
+				SONIC_EXT_COPP_N_CLASSES - 1);
+  for (i = 0; i < SONIC_EXT_COPP_N_CLASSES; i++)
+    {
+      vlib_zero_simple_counter (&sem->punt_queue_steered, i);
+      vlib_zero_simple_counter (&sem->punt_queue_limit_drops, i);
+    }
+
+#define _(sym, str)                                                           \
+  sem->latency[SONIC_EXT_LATENCY_EXIT_##sym].name = "punt-latency-" str;      \
+  sem->latency[SONIC_EXT_LATENCY_EXIT_##sym].stat_segment_name =              \
+    "/sonic-ext/punt-latency/" str;                                           \
+  vlib_validate_simple_counter (&sem->latency[SONIC_EXT_LATENCY_EXIT_##sym],  \
+				SONIC_EXT_LATENCY_N_BINS - 1);
+  foreach_sonic_ext_latency_exit
+#undef _
+  sonic_ext_punt_latency_clear ();
+}
+
 static clib_error_t *
 sonic_ext_init (vlib_main_t *vm)
 {
@@ -439,8 +1239,35 @@ sonic_ext_init (vlib_main_t *vm)
     .pair_add_fn = sonic_ext_lcp_pair_add_cb,
     .pair_del_fn = sonic_ext_lcp_pair_del_cb,
   };
+  vnet_main_t *vnm = vnet_get_main ();
+  vnet_sw_interface_t *swi;
+  ip4_add_del_interface_address_callback_t cb4 = {
+    .function = sonic_ext_ip4_address_add_del_cb,
+  };
+  ip6_add_del_interface_address_callback_t cb6 = {
+    .function = sonic_ext_ip6_address_add_del_cb,
+  };
+
   clib_memset (sem, 0, sizeof (*sem));
+
+  sonic_ext_counters_init ();
+
+  /* A switch has a handful of addresses per table; size for a few
+   * hundred without ever growing. */
+  clib_bihash_init_8_8 (&sem->ip2me_local4, "sonic-ext ip2me ip4", 64,
+			1 << 20);
+  clib_bihash_init_24_8 (&sem->ip2me_local6, "sonic-ext ip2me ip6", 64,
+			 1 << 20);
+  vec_add1 (ip4_main.add_del_interface_address_callbacks, cb4);
+  vec_add1 (ip6_main.add_del_interface_address_callbacks, cb6);
+
+  /* Interfaces created before us (local0, early startup.conf ports)
+   * never went through the add/del callback. */
+  pool_foreach (swi, vnm->interface_main.sw_interfaces)
+    sonic_ext_sw_interface_add_del (vnm, swi->sw_if_index, 1);
+
   lcp_itf_pair_register_vft (&sonic_ext_lcp_vft);
+  vnet_feature_register (sonic_ext_feature_update_cb, NULL);
 
   /* Default-on: capture + aggr-tap-redirect (punt-via-member) and
    * host-xc.  At init time no LCP pairs exist yet, so the walks
@@ -451,8 +1278,38 @@ sonic_ext_init (vlib_main_t *vm)
    * at runtime. */
   sonic_ext_set_punt_via_member (1);
   sonic_ext_set_host_xc (1);
+  sonic_ext_punt_queue_defaults ();
+
+  /* ~1ms, matching VPP's own ARP throttle granularity; no budgets. */
+  sem->glean_window = 1e-3;
 
   return 0;
 }
 
 VLIB_INIT_FUNCTION (sonic_ext_init);
+
+/*
+ * Size the per-thread glean budget buckets.  Unlike the simple
+ * counters, which size themselves from the thread count configured at
+ * init, these are indexed by vlib_get_n_threads (), which only counts
+ * the worker mains once they have been started; like the glean
+ * throttle they have to wait for main-loop enter.
+ */
+static clib_error_t *
+sonic_ext_main_loop_enter (vlib_main_t *vm)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  sonic_ext_glean_per_thread_t *pt;
+  u32 n_if = pool_len (vnet_get_main ()->interface_main.sw_interfaces);
+
+  vec_validate_aligned (sem->glean_per_thread, vlib_get_n_threads () - 1,
+			CLIB_CACHE_LINE_BYTES);
+  if (n_if)
+    vec_foreach (pt, sem->glean_per_thread)
+      vec_validate (pt->by_if, n_if - 1);
+  sonic_ext_glean_update_limits ();
+
+  return 0;
+}
+
+VLIB_MAIN_LOOP_ENTER_FUNCTION (sonic_ext_main_loop_enter);
@@ -21,6 +21,11 @@
 #include <vnet/feature/feature.h>
 #include <vnet/l2/l2_input.h>
 #include <vnet/l2/l2_bvi.h>
+#include <vnet/util/throttle.h>
+#include <vnet/ip/ip4_packet.h>
+#include <vnet/ip/ip6_packet.h>
+#include <vppinfra/bihash_8_8.h>
+#include <vppinfra/bihash_24_8.h>
 #include <plugins/linux-cp/lcp_interface.h>
 
 #define SONIC_EXT_PLUGIN_BUILD_VER "1.0"
@@ -56,6 +61,11 @@
  */
 #define SONIC_EXT_BUFFER_MAGIC 0x534e4358u  /* 'SNCX' */
 
+/* A cookie that one of the redirect nodes has already acted on.  Never
+ * redirected again, and no longer a latency sample: the redirect took
+ * it (see sonic_ext_latency_record). */
+#define SONIC_EXT_BUFFER_MAGIC_DONE 0x534e4344u  /* 'SNCD' */
+
 /*
  * orig_vlan_tag: outermost 802.1Q (or 802.1ad) tag observed on the
  * wire frame at sonic-ext-capture time, stored as raw 4 bytes in
@@ -79,12 +89,18 @@
  * The aggr-tap-redirect node uses this saved tag to re-push the
  * VLAN before re-entering interface-output on the member tap, so
  * Linux observes the same wire frame on the right netdev.
+ *
+ * ingress_ts: low 32 bits of the CPU tick counter at capture time, or
+ * zero when punt latency measurement is off.  32 bits are over a
+ * second at any realistic clock rate, far more than a packet may spend
+ * in VPP, and unsigned subtraction handles the wrap.
  */
 typedef struct
 {
   u32 magic;
   u32 orig_rx_sw_if_index;
   u32 orig_vlan_tag;
+  u32 ingress_ts;
 } sonic_ext_buffer_opaque_t;
 
 STATIC_ASSERT (sizeof (sonic_ext_buffer_opaque_t) <=
@@ -97,6 +113,117 @@ sonic_ext_buffer (vlib_buffer_t *b)
   return (sonic_ext_buffer_opaque_t *) vnet_buffer2 (b)->unused;
 }
 
+#define foreach_sonic_ext_counter                                             \
+  _ (CAPTURES, "captures")                                                    \
+  _ (AGGR_TAP_REDIRECTS, "aggr-tap redir")                                    \
+  _ (GLEAN_REDIRECTS, "glean redirect")                                       \
+  _ (HOST_XC_DIRECT, "host-xc direct")                                        \
+  _ (L2_TRAP_FIXUPS, "l2 trap fixups")                                        \
+  _ (IP2ME_HITS, "ip2me hits")
+
+typedef enum
+{
+#define _(sym, str) SONIC_EXT_COUNTER_##sym,
+  foreach_sonic_ext_counter
+#undef _
+    SONIC_EXT_N_COUNTERS,
+} sonic_ext_counter_t;
+
+/*
+ * CoPP trap classes policed by sonic-ext-copp.  The order is part of
+ * the binary API (vl_api_sonic_ext_copp_class_t) and of the stats
+ * segment layout (/sonic-ext/copp/{passed,dropped}[class]).
+ */
+#define foreach_sonic_ext_copp_class                                          \
+  _ (ARP, "arp")                                                              \
+  _ (ND, "nd")                                                                \
+  _ (BGP, "bgp")                                                              \
+  _ (LACP, "lacp")                                                            \
+  _ (LLDP, "lldp")                                                            \
+  _ (DHCP, "dhcp")                                                            \
+  _ (IP2ME, "ip2me")                                                          \
+  _ (TTL_EXPIRY, "ttl-expiry")                                                \
+  _ (OTHER, "other")
+
+typedef enum
+{
+#define _(sym, str) SONIC_EXT_COPP_CLASS_##sym,
+  foreach_sonic_ext_copp_class
+#undef _
+    SONIC_EXT_COPP_N_CLASSES,
+} sonic_ext_copp_class_t;
+
+typedef struct
+{
+  /* As programmed; rate 0 means "not policed". */
+  u32 rate_pps;
+  u32 burst;
+} sonic_ext_copp_class_cfg_t;
+
+/*
+ * A class's token bucket, shared by all threads and updated lock-free
+ * (see sonic-ext-copp).  Kept as the time, in nanoseconds, at which
+ * the bucket would be full again: one word, so a single compare-and-
+ * swap takes tokens and refills at once.  0 means full.
+ */
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  u64 full_at;
+} sonic_ext_copp_bucket_t;
+
+/*
+ * glean-redirect punt budgets: token buckets in packets, one for the
+ * whole thread and one per ingress sw_if_index, on top of the
+ * per-(adjacency, ingress) throttle window.
+ */
+typedef struct
+{
+  f64 tokens;
+  f64 last;
+} sonic_ext_glean_bucket_t;
+
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  sonic_ext_glean_bucket_t global;
+  sonic_ext_glean_bucket_t *by_if;
+} sonic_ext_glean_per_thread_t;
+
+/*
+ * Punt latency: log2 histograms of capture -> exit CPU ticks, one per
+ * exit point, bin i counting latencies in [2^i, 2^(i+1)) ticks.
+ */
+#define SONIC_EXT_LATENCY_N_BINS 32
+
+#define foreach_sonic_ext_latency_exit                                        \
+  _ (AGGR_TAP, "aggr-tap")                                                    \
+  _ (GLEAN, "glean")                                                          \
+  _ (TAP_TX, "tap-tx")
+
+typedef enum
+{
+#define _(sym, str) SONIC_EXT_LATENCY_EXIT_##sym,
+  foreach_sonic_ext_latency_exit
+#undef _
+    SONIC_EXT_LATENCY_N_EXITS,
+} sonic_ext_latency_exit_t;
+
+/*
+ * Priority punt: per trap class, the host tap TX queue it is steered to
+ * (taken modulo the tap's queue count), its strict priority (0 is
+ * served first) and the most packets it may submit out of one frame
+ * (0 = no limit).  Priority is applied within a frame only.
+ */
+#define SONIC_EXT_PUNT_N_PRIOS 4
+
+typedef struct
+{
+  u8 priority;
+  u16 queue;
+  u32 frame_limit;
+} sonic_ext_punt_queue_cfg_t;
+
 typedef struct
 {
   /* API message ID base */
@@ -112,18 +239,207 @@ typedef struct
   u8 host_xc_enabled;
   u8 glean_redirect_enabled;
 
-  /* Counters (per-feature, per-thread accounting kept in node
-   * registrations; these are summary counters for `show sonic-ext`). */
-  u64 captures;
-  u64 aggr_tap_redirects;
-  u64 glean_redirects;
-  u64 host_xc_direct;
-  u64 l2_trap_fixups;
-  u64 ip2me_hits;
+  /* On-demand capture: only run sonic-ext-capture on ports that can
+   * feed an aggregate (bond members, BVI bridge members) rather than on
+   * every LCP phy.  capture_sw_if_indexes is the set of phys capture is
+   * currently enabled on. */
+  u8 capture_on_demand;
+  uword *capture_sw_if_indexes;
+
+  /* glean-redirect state, seeded at main-loop enter.  Kept here rather
+   * than as file statics in glean_redirect_node.c: that file is built
+   * once per march variant, and each variant would otherwise get its own
+   * (never initialized) copy. */
+  throttle_t glean_throttle;
+  u32 glean_src_nodes[3];
+  uword *glean_src_errors;
+
+  /* glean-redirect punt limits (sonic_ext_set_glean_limits): the
+   * throttle window in seconds, and the per-ingress-port and global
+   * budgets in packets per second (0 = unlimited) with each thread's
+   * share of the global one; every thread enforces the full port
+   * budget.  Packets held back by any of the three are counted per
+   * ingress port at /sonic-ext/if/glean-throttled. */
+  f64 glean_window;
+  u32 glean_if_rate;
+  u32 glean_global_rate;
+  f64 glean_thread_global_rate;
+  sonic_ext_glean_per_thread_t *glean_per_thread;
+
+  /* Flat sw_if_index-indexed lookup tables for the fast paths, ~0 for
+   * "none".  Maintained from the LCP pair vft (host <-> phy) and the
+   * sw interface add/del callback (sub -> parent), always under the
+   * worker barrier, so nodes read them with a single bounds-checked
+   * load instead of walking the linux-cp and interface pools. */
+  u32 *phy_by_host;
+  u32 *host_by_phy;
+  u32 *parent_by_sw;
+
+  /* host-xc direct-to-TX: phy -> next index of sonic-ext-host-xc that
+   * leads to the phy's device TX node (hw tx_node_index), ~0 if
+   * none.  Used only while host_xc_direct_tx is on. */
+  u8 host_xc_direct_tx;
+  u32 *tx_next_by_phy;
+
+  /* CoPP: per-class policer config, token buckets and per-class
+   * pass / drop counters (/sonic-ext/copp/passed, .../dropped). */
+  u8 copp_enabled;
+  sonic_ext_copp_class_cfg_t copp_classes[SONIC_EXT_COPP_N_CLASSES];
+  sonic_ext_copp_bucket_t copp_buckets[SONIC_EXT_COPP_N_CLASSES];
+  vlib_simple_counter_main_t copp_passed;
+  vlib_simple_counter_main_t copp_dropped;
+
+  /* Priority punt to multi-queue host taps, done by sonic-ext-copp.
+   * The copp feature is on the host taps while either CoPP or priority
+   * punt is enabled (copp_feature_on).  tx_next_by_host is the
+   * sonic-ext-copp next index of each host tap's device TX node (hw
+   * tx_node_index), not of <tap>-output: that would run the tap's
+   * output arc, and this node, a second time and pick its own queue. */
+  u8 punt_prio;
+  u8 copp_feature_on;
+  sonic_ext_punt_queue_cfg_t punt_queues[SONIC_EXT_COPP_N_CLASSES];
+  u32 *tx_next_by_host;
+  vlib_simple_counter_main_t punt_queue_steered;
+  vlib_simple_counter_main_t punt_queue_limit_drops;
+
+  /* Punt latency: capture stamps ingress_ts while latency_enabled; the
+   * exits record into per-thread histograms, one simple counter per
+   * exit with a counter per bin (/sonic-ext/punt-latency/<exit>).  The
+   * tap-tx exit is sonic-ext-copp, so it also keeps that feature on. */
+  u8 latency_enabled;
+  vlib_simple_counter_main_t latency[SONIC_EXT_LATENCY_N_EXITS];
+
+  /* ip2me local-address tables: every interface address -- the
+   * addresses VPP installs a receive route for -- keyed by (fib_index,
+   * address) and refcounted, so sonic-ext-ip2me answers "is this for
+   * us" with one exact-match probe instead of an LPM.  Fed by the ip4 /
+   * ip6 interface address callbacks; a miss falls back to the LPM. */
+  clib_bihash_8_8_t ip2me_local4;
+  clib_bihash_24_8_t ip2me_local6;
+  u32 ip2me_n_local4;
+  u32 ip2me_n_local6;
+
+  /* Summary counters for `show sonic-ext`, indexed by
+   * sonic_ext_counter_t.  Per-thread (one cache-aligned vector per
+   * worker) and exported at /sonic-ext/summary, so the fast paths never
+   * share a cache line; readers sum across threads. */
+  vlib_simple_counter_main_t counters;
+
+  /* Per-interface counters, indexed by sw_if_index, for telemetry that
+   * reads the stats segment directly:
+   *   /sonic-ext/if/punt-redirects  punts steered (aggr-tap / glean)
+   *                                 back to the tap of this ingress port
+   *   /sonic-ext/if/host-xc         host tap packets sent out this phy
+   *   /sonic-ext/if/glean-throttled glean punts from this ingress port
+   *                                 held back by the glean limits
+   * Validated per interface once named in sonic_ext_counters_init,
+   * see sonic_ext_if_counters_validate. */
+  u8 if_counters_ready;
+  vlib_simple_counter_main_t if_punt_redirects;
+  vlib_simple_counter_main_t if_host_xc;
+  vlib_simple_counter_main_t if_glean_throttled;
 } sonic_ext_main_t;
 
 extern sonic_ext_main_t sonic_ext_main;
 
+static_always_inline void
+sonic_ext_counter_add (vlib_main_t *vm, sonic_ext_counter_t c, u32 n)
+{
+  if (n)
+    vlib_increment_simple_counter (&sonic_ext_main.counters, vm->thread_index,
+				   c, n);
+}
+
+/* LCP host tap -> paired phy, or ~0 if sw_if_index is not a host tap. */
+static_always_inline u32
+sonic_ext_host_to_phy (u32 host_sw_if_index)
+{
+  u32 *v = sonic_ext_main.phy_by_host;
+  return host_sw_if_index < vec_len (v) ? v[host_sw_if_index] : ~0;
+}
+
+/* LCP phy -> paired host tap, or ~0 if phy has no linux-cp pair. */
+static_always_inline u32
+sonic_ext_phy_to_host (u32 phy_sw_if_index)
+{
+  u32 *v = sonic_ext_main.host_by_phy;
+  return phy_sw_if_index < vec_len (v) ? v[phy_sw_if_index] : ~0;
+}
+
+/* Sub-interface -> parent (sup) sw_if_index; a main interface maps to
+ * itself.  ~0 if sw_if_index does not exist. */
+static_always_inline u32
+sonic_ext_sw_parent (u32 sw_if_index)
+{
+  u32 *v = sonic_ext_main.parent_by_sw;
+  return sw_if_index < vec_len (v) ? v[sw_if_index] : ~0;
+}
+
+/* LCP phy -> sonic-ext-host-xc next index of its device TX node, or ~0. */
+static_always_inline u32
+sonic_ext_phy_tx_next (u32 phy_sw_if_index)
+{
+  u32 *v = sonic_ext_main.tx_next_by_phy;
+  return phy_sw_if_index < vec_len (v) ? v[phy_sw_if_index] : ~0;
+}
+
+/* LCP host tap -> sonic-ext-copp next index of its device TX node, or ~0. */
+static_always_inline u32
+sonic_ext_host_tx_next (u32 host_sw_if_index)
+{
+  u32 *v = sonic_ext_main.tx_next_by_host;
+  return host_sw_if_index < vec_len (v) ? v[host_sw_if_index] : ~0;
+}
+
+/* Capture-side timestamp; never 0 so that 0 can mean "not stamped". */
+static_always_inline u32
+sonic_ext_latency_now (void)
+{
+  return (u32) clib_cpu_time_now () | 1;
+}
+
+/* Each capture is one sample, taken at the first exit it reaches: the
+ * stamp is cleared once recorded. */
+static_always_inline void
+sonic_ext_latency_record (vlib_main_t *vm, sonic_ext_latency_exit_t e,
+			  sonic_ext_buffer_opaque_t *seb, u32 now)
+{
+  u32 d;
+
+  if (!seb->ingress_ts)
+    return;
+  d = now - seb->ingress_ts;
+  seb->ingress_ts = 0;
+  vlib_increment_simple_counter (&sonic_ext_main.latency[e], vm->thread_index,
+				 d ? min_log2 (d) : 0, 1);
+}
+
+static_always_inline void
+sonic_ext_if_counter_add (vlib_main_t *vm, vlib_simple_counter_main_t *cm,
+			  u32 sw_if_index, u32 n)
+{
+  vlib_increment_simple_counter (cm, vm->thread_index, sw_if_index, n);
+}
+
+/* ip2me local-address table keys, see sonic_ext_main_t.ip2me_local4/6. */
+static_always_inline void
+sonic_ext_ip2me_key4 (clib_bihash_kv_8_8_t *kv, u32 fib_index,
+		      const ip4_address_t *a)
+{
+  kv->key = ((u64) fib_index << 32) | a->as_u32;
+  kv->value = 0;
+}
+
+static_always_inline void
+sonic_ext_ip2me_key6 (clib_bihash_kv_24_8_t *kv, u32 fib_index,
+		      const ip6_address_t *a)
+{
+  kv->key[0] = a->as_u64[0];
+  kv->key[1] = a->as_u64[1];
+  kv->key[2] = fib_index;
+  kv->value = 0;
+}
+
 extern vlib_node_registration_t sonic_ext_capture_node;
 extern vlib_node_registration_t sonic_ext_aggr_tap_redirect_node;
 extern vlib_node_registration_t sonic_ext_glean_redirect_node;
@@ -131,9 +447,10 @@ extern vlib_node_registration_t sonic_ext_host_xc_node;
 extern vlib_node_registration_t sonic_ext_l2_trap_fixup_node;
 extern vlib_node_registration_t sonic_ext_ip2me_ip4_node;
 extern vlib_node_registration_t sonic_ext_ip2me_ip6_node;
+extern vlib_node_registration_t sonic_ext_copp_node;
 
 /* Enable / disable sonic-ext-capture on a given interface.  No-op if
- * the capture sidecar is not yet initialized. */
+ * capture is already in the requested state. */
 void sonic_ext_capture_enable_disable (u32 sw_if_index, int enable);
 
 /* Enable / disable sonic-ext-host-xc on a given interface. */
@@ -144,6 +461,11 @@ void sonic_ext_host_xc_enable_disable (u32 sw_if_index, int enable);
  * tomorrow).  Driven from the LCP pair add/del callback. */
 void sonic_ext_aggr_tap_redirect_enable_disable (u32 sw_if_index, int enable);
 
+/* Enable / disable sonic-ext-copp on a given sw_if_index (always an LCP
+ * host tap).  Driven from sonic_ext_set_copp and the LCP pair add/del
+ * callback. */
+void sonic_ext_copp_enable_disable (u32 sw_if_index, int enable);
+
 /* Enable / disable sonic-ext-glean-redirect.  Global (the ip4-drop /
  * ip6-drop arcs dispatch with sw_if_index 0), so there is no
  * per-interface argument; the node scopes itself per packet via the
@@ -170,6 +492,66 @@ void sonic_ext_ip2me_enable_disable (u32 sw_if_index, int enable);
 void sonic_ext_set_punt_via_member (u8 is_enable);
 void sonic_ext_set_host_xc (u8 is_enable);
 
+/* Let sonic-ext-host-xc bypass interface-output and enqueue whole
+ * single-tap frames straight to the phy's device TX node. */
+void sonic_ext_set_host_xc_direct_tx (u8 is_enable);
+
+/* Switch sonic-ext-capture between every LCP phy (the default) and
+ * only the phys that can feed an aggregate, resyncing immediately. */
+void sonic_ext_set_capture_on_demand (u8 on_demand);
+
+/* Turn sonic-ext-copp on / off on every LCP host tap. */
+void sonic_ext_set_copp (u8 is_enable);
+
+/* Program the policer of one trap class: rate in packets per second
+ * (0 = not policed) and burst in packets (0 = one second's worth). */
+int sonic_ext_copp_set_class (sonic_ext_copp_class_t c, u32 rate_pps,
+			      u32 burst);
+
+/* Turn priority punt to multi-queue host taps on / off, and program
+ * one class's queue, priority and per-frame limit. */
+void sonic_ext_set_punt_prio (u8 is_enable);
+int sonic_ext_punt_queue_set_class (sonic_ext_copp_class_t c, u16 queue,
+				    u8 priority, u32 frame_limit);
+
+/* One pair of a bulk LCP create / delete.  host_if_name is a
+ * NUL-terminated vector (add only); host_sw_if_index and rv are filled
+ * in per pair. */
+typedef struct
+{
+  u32 phy_sw_if_index;
+  u8 *host_if_name;
+  u32 host_sw_if_index;
+  int rv;
+} sonic_ext_lcp_pair_req_t;
+
+/* Host tap offloads for a bulk LCP create: GSO with checksum offload
+ * between the kernel and VPP, and GRO (packet coalescing) on VPP's
+ * transmit into the kernel, which implies GSO. */
+#define SONIC_EXT_LCP_F_GSO (1 << 0)
+#define SONIC_EXT_LCP_F_GRO (1 << 1)
+
+/* Create (or delete) the linux-cp pairs of every request under a
+ * single worker barrier, with the SONIC_EXT_LCP_F_* offloads on each
+ * new host tap.  Returns the first per-pair error, 0 if all
+ * succeeded. */
+int sonic_ext_lcp_pairs_add_del (sonic_ext_lcp_pair_req_t *reqs, int is_add,
+				 u32 flags);
+
+/* Program the glean-redirect punt limits: throttle window in
+ * microseconds (one punt per adjacency and ingress port per window),
+ * per-ingress-port and global budgets in packets per second
+ * (0 = unlimited). */
+int sonic_ext_set_glean_limits (u32 window_usec, u32 if_rate_pps,
+				u32 global_rate_pps);
+
+/* Turn punt latency measurement on / off, and zero the histograms. */
+void sonic_ext_set_punt_latency (u8 is_enable);
+void sonic_ext_punt_latency_clear (void);
+
+format_function_t format_sonic_ext_copp_class;
+unformat_function_t unformat_sonic_ext_copp_class;
+
 /* Returns non-zero if phy_sw_if_index is an "aggregate" parent whose
  * LCP host tap should have the aggr-tap-redirect feature enabled --
  * today that means a BVI, a bond / port-channel master, or a routed
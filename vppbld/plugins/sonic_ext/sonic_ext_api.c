@@ -19,7 +19,12 @@
  * Exposes sonic_ext_ip2me_enable_disable so the SAI-VPP layer
  * (sonic-sairedis) can enable the "receive-DPO check before ACL" feature
  * on exactly the L2 ports where an ingress drop ACL that could discard
- * ip2me traffic is bound.
+ * ip2me traffic is bound, and the sonic_ext_copp_* messages that let it
+ * program the per-trap punt policers and host tap queues from the COPP
+ * table, the punt latency histogram controls, the glean-redirect punt
+ * limits, bulk linux-cp pair creation for the hostif script, and
+ * read-only state / counter queries for telemetry that should not
+ * screen-scrape "show sonic-ext" through vppctl.
  */
 
 #include <vnet/vnet.h>
@@ -56,13 +61,291 @@ exit:
   REPLY_MACRO (VL_API_SONIC_EXT_IP2ME_ENABLE_DISABLE_REPLY);
 }
 
+static void
+vl_api_sonic_ext_copp_enable_disable_t_handler (
+  vl_api_sonic_ext_copp_enable_disable_t *mp)
+{
+  vl_api_sonic_ext_copp_enable_disable_reply_t *rmp;
+  int rv = 0;
+
+  sonic_ext_set_copp (mp->enable ? 1 : 0);
+
+  REPLY_MACRO (VL_API_SONIC_EXT_COPP_ENABLE_DISABLE_REPLY);
+}
+
+static void
+vl_api_sonic_ext_copp_set_class_t_handler (
+  vl_api_sonic_ext_copp_set_class_t *mp)
+{
+  vl_api_sonic_ext_copp_set_class_reply_t *rmp;
+  int rv;
+
+  rv = sonic_ext_copp_set_class ((sonic_ext_copp_class_t) mp->trap_class,
+				 ntohl (mp->rate_pps), ntohl (mp->burst));
+
+  REPLY_MACRO (VL_API_SONIC_EXT_COPP_SET_CLASS_REPLY);
+}
+
+static void
+vl_api_sonic_ext_punt_queue_enable_disable_t_handler (
+  vl_api_sonic_ext_punt_queue_enable_disable_t *mp)
+{
+  vl_api_sonic_ext_punt_queue_enable_disable_reply_t *rmp;
+  int rv = 0;
+
+  sonic_ext_set_punt_prio (mp->enable ? 1 : 0);
+
+  REPLY_MACRO (VL_API_SONIC_EXT_PUNT_QUEUE_ENABLE_DISABLE_REPLY);
+}
+
+static void
+vl_api_sonic_ext_punt_queue_set_class_t_handler (
+  vl_api_sonic_ext_punt_queue_set_class_t *mp)
+{
+  vl_api_sonic_ext_punt_queue_set_class_reply_t *rmp;
+  int rv;
+
+  rv = sonic_ext_punt_queue_set_class (
+    (sonic_ext_copp_class_t) mp->trap_class, ntohs (mp->queue), mp->priority,
+    ntohl (mp->frame_limit));
+
+  REPLY_MACRO (VL_API_SONIC_EXT_PUNT_QUEUE_SET_CLASS_REPLY);
+}
+
+static void
+vl_api_sonic_ext_punt_latency_enable_disable_t_handler (
+  vl_api_sonic_ext_punt_latency_enable_disable_t *mp)
+{
+  vl_api_sonic_ext_punt_latency_enable_disable_reply_t *rmp;
+  int rv = 0;
+
+  sonic_ext_set_punt_latency (mp->enable ? 1 : 0);
+  if (mp->clear)
+    sonic_ext_punt_latency_clear ();
+
+  REPLY_MACRO (VL_API_SONIC_EXT_PUNT_LATENCY_ENABLE_DISABLE_REPLY);
+}
+
+static void
+vl_api_sonic_ext_punt_latency_get_t_handler (
+  vl_api_sonic_ext_punt_latency_get_t *mp)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  vl_api_sonic_ext_punt_latency_get_reply_t *rmp;
+  vlib_main_t *vm = vlib_get_main ();
+  int rv = 0;
+  u32 i;
+
+  STATIC_ASSERT (ARRAY_LEN (rmp->tap_tx) == SONIC_EXT_LATENCY_N_BINS,
+		 "punt latency API bin count mismatch");
+
+  REPLY_MACRO2 (VL_API_SONIC_EXT_PUNT_LATENCY_GET_REPLY, ({
+		  rmp->clocks_per_second =
+		    clib_host_to_net_f64 (vm->clib_time.clocks_per_second);
+		  for (i = 0; i < SONIC_EXT_LATENCY_N_BINS; i++)
+		    {
+		      rmp->aggr_tap[i] = clib_host_to_net_u64 (
+			vlib_get_simple_counter (
+			  &sem->latency[SONIC_EXT_LATENCY_EXIT_AGGR_TAP], i));
+		      rmp->glean[i] = clib_host_to_net_u64 (
+			vlib_get_simple_counter (
+			  &sem->latency[SONIC_EXT_LATENCY_EXIT_GLEAN], i));
+		      rmp->tap_tx[i] = clib_host_to_net_u64 (
+			vlib_get_simple_counter (
+			  &sem->latency[SONIC_EXT_LATENCY_EXIT_TAP_TX], i));
+		    }
+		}));
+}
+
+static void
+vl_api_sonic_ext_glean_set_limits_t_handler (
+  vl_api_sonic_ext_glean_set_limits_t *mp)
+{
+  vl_api_sonic_ext_glean_set_limits_reply_t *rmp;
+  int rv;
+
+  rv = sonic_ext_set_glean_limits (ntohl (mp->window_usec),
+				   ntohl (mp->if_rate_pps),
+				   ntohl (mp->global_rate_pps));
+
+  REPLY_MACRO (VL_API_SONIC_EXT_GLEAN_SET_LIMITS_REPLY);
+}
+
+static void
+vl_api_sonic_ext_glean_get_limits_t_handler (
+  vl_api_sonic_ext_glean_get_limits_t *mp)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  vl_api_sonic_ext_glean_get_limits_reply_t *rmp;
+  int rv = 0;
+
+  REPLY_MACRO2 (VL_API_SONIC_EXT_GLEAN_GET_LIMITS_REPLY, ({
+		  rmp->window_usec = htonl ((u32) (sem->glean_window * 1e6 +
+						   0.5));
+		  rmp->if_rate_pps = htonl (sem->glean_if_rate);
+		  rmp->global_rate_pps = htonl (sem->glean_global_rate);
+		}));
+}
+
+static void
+vl_api_sonic_ext_punt_via_member_enable_disable_t_handler (
+  vl_api_sonic_ext_punt_via_member_enable_disable_t *mp)
+{
+  vl_api_sonic_ext_punt_via_member_enable_disable_reply_t *rmp;
+  int rv = 0;
+
+  sonic_ext_set_punt_via_member (mp->enable ? 1 : 0);
+
+  REPLY_MACRO (VL_API_SONIC_EXT_PUNT_VIA_MEMBER_ENABLE_DISABLE_REPLY);
+}
+
+static void
+vl_api_sonic_ext_host_xc_enable_disable_t_handler (
+  vl_api_sonic_ext_host_xc_enable_disable_t *mp)
+{
+  vl_api_sonic_ext_host_xc_enable_disable_reply_t *rmp;
+  int rv = 0;
+
+  sonic_ext_set_host_xc (mp->enable ? 1 : 0);
+
+  REPLY_MACRO (VL_API_SONIC_EXT_HOST_XC_ENABLE_DISABLE_REPLY);
+}
+
+static void
+vl_api_sonic_ext_capture_on_demand_t_handler (
+  vl_api_sonic_ext_capture_on_demand_t *mp)
+{
+  vl_api_sonic_ext_capture_on_demand_reply_t *rmp;
+  int rv = 0;
+
+  sonic_ext_set_capture_on_demand (mp->enable ? 1 : 0);
+
+  REPLY_MACRO (VL_API_SONIC_EXT_CAPTURE_ON_DEMAND_REPLY);
+}
+
+static void
+vl_api_sonic_ext_lcp_pair_add_del_bulk_t_handler (
+  vl_api_sonic_ext_lcp_pair_add_del_bulk_t *mp)
+{
+  vl_api_sonic_ext_lcp_pair_add_del_bulk_reply_t *rmp;
+  sonic_ext_lcp_pair_req_t *reqs = 0, *req;
+  u32 i, n_pairs = ntohl (mp->n_pairs), flags = 0;
+  int rv = 0;
+
+  vec_validate (reqs, n_pairs);
+  vec_set_len (reqs, n_pairs);
+  for (i = 0; i < n_pairs; i++)
+    {
+      vl_api_sonic_ext_lcp_pair_t *p = &mp->pairs[i];
+
+      req = vec_elt_at_index (reqs, i);
+      req->phy_sw_if_index = ntohl (p->phy_sw_if_index);
+      /* lcp_itf_pair_create expects a NUL-terminated vector */
+      vec_add (req->host_if_name, p->host_if_name,
+	       clib_strnlen ((char *) p->host_if_name,
+			     sizeof (p->host_if_name) - 1));
+      vec_add1 (req->host_if_name, 0);
+    }
+
+  if (mp->gso)
+    flags |= SONIC_EXT_LCP_F_GSO;
+  if (mp->gro)
+    flags |= SONIC_EXT_LCP_F_GSO | SONIC_EXT_LCP_F_GRO;
+
+  rv = sonic_ext_lcp_pairs_add_del (reqs, mp->is_add, flags);
+
+  REPLY_MACRO3 (VL_API_SONIC_EXT_LCP_PAIR_ADD_DEL_BULK_REPLY,
+		n_pairs * sizeof (rmp->status[0]), ({
+		  rmp->n_pairs = htonl (n_pairs);
+		  for (i = 0; i < n_pairs; i++)
+		    {
+		      req = vec_elt_at_index (reqs, i);
+		      rmp->status[i].phy_sw_if_index =
+			htonl (req->phy_sw_if_index);
+		      rmp->status[i].host_sw_if_index =
+			htonl (req->host_sw_if_index);
+		      rmp->status[i].retval = htonl (req->rv);
+		    }
+		}));
+
+  vec_foreach (req, reqs)
+    vec_free (req->host_if_name);
+  vec_free (reqs);
+}
+
+static void
+vl_api_sonic_ext_get_state_t_handler (vl_api_sonic_ext_get_state_t *mp)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  vl_api_sonic_ext_get_state_reply_t *rmp;
+  int rv = 0;
+
+  REPLY_MACRO2 (VL_API_SONIC_EXT_GET_STATE_REPLY, ({
+		  rmp->punt_via_member = sem->punt_via_member;
+		  rmp->host_xc = sem->host_xc;
+		  rmp->host_xc_direct_tx = sem->host_xc_direct_tx;
+		  rmp->capture_on_demand = sem->capture_on_demand;
+		  rmp->n_capture_ports = htonl (
+		    clib_bitmap_count_set_bits (sem->capture_sw_if_indexes));
+		  rmp->copp = sem->copp_enabled;
+		  rmp->punt_queue = sem->punt_prio;
+		  rmp->punt_latency = sem->latency_enabled;
+		}));
+}
+
+static void
+send_sonic_ext_counters_details (vl_api_registration_t *reg, u32 context,
+				 const char *name, u64 value)
+{
+  vl_api_sonic_ext_counters_details_t *mp;
+
+  mp = vl_msg_api_alloc_zero (sizeof (*mp));
+  mp->_vl_msg_id =
+    htons (VL_API_SONIC_EXT_COUNTERS_DETAILS + sonic_ext_main.msg_id_base);
+  mp->context = context;
+  strncpy ((char *) mp->name, name, ARRAY_LEN (mp->name) - 1);
+  mp->value = clib_host_to_net_u64 (value);
+
+  vl_api_send_msg (reg, (u8 *) mp);
+}
+
+static void
+vl_api_sonic_ext_counters_dump_t_handler (
+  vl_api_sonic_ext_counters_dump_t *mp)
+{
+  sonic_ext_main_t *sem = &sonic_ext_main;
+  vl_api_registration_t *reg;
+
+  reg = vl_api_client_index_to_registration (mp->client_index);
+  if (!reg)
+    return;
+
+#define _(sym, str)                                                           \
+  send_sonic_ext_counters_details (                                           \
+    reg, mp->context, str,                                                    \
+    vlib_get_simple_counter (&sem->counters, SONIC_EXT_COUNTER_##sym));
+  foreach_sonic_ext_counter
+#undef _
+}
+
 /* API definitions */
 #include <sonic_ext/sonic_ext.api.c>
 
 static clib_error_t *
 sonic_ext_api_init (vlib_main_t *vm)
 {
+  api_main_t *am = vlibapi_get_main ();
+
   sonic_ext_main.msg_id_base = setup_message_id_table ();
+
+  /* Flag flips once wired, see sonic_ext_set_punt_via_member. */
+  vl_api_set_msg_thread_safe (
+    am,
+    sonic_ext_main.msg_id_base + VL_API_SONIC_EXT_PUNT_VIA_MEMBER_ENABLE_DISABLE,
+    1);
+  vl_api_set_msg_thread_safe (
+    am, sonic_ext_main.msg_id_base + VL_API_SONIC_EXT_HOST_XC_ENABLE_DISABLE,
+    1);
   return 0;
 }
 
@@ -0,0 +1,46 @@
+"""
+pg benchmark helpers shared by the plugin tests in this tree.
+
+The test runner puts every plugin's test directory on sys.path, so the
+ip_validate tests import this module as well.  Numbers come from
+"show runtime" after a "clear runtime": clocks per packet of one node,
+for a stream sent on a single pg interface.
+"""
+
+# 64B frames, enough of them for many full vectors.
+BENCH_N_PKTS = 256 * 100
+
+
+def node_clocks_per_packet(test, node):
+    """Clocks/vector of node since the last "clear runtime"."""
+    for line in test.vapi.cli("show runtime %s" % node).splitlines():
+        fields = line.split()
+        if fields and fields[0] == node:
+            # name state calls vectors suspends clocks vectors/call
+            return float(fields[5])
+    test.fail("%s not in show runtime" % node)
+
+
+def bench_node(test, pg, pkt, node, n_pkts=BENCH_N_PKTS):
+    """Send n_pkts copies of pkt on pg; return node's clocks/packet."""
+    test.vapi.cli("clear runtime")
+    pg.add_stream([pkt] * n_pkts)
+    test.pg_enable_capture(test.pg_interfaces)
+    test.pg_start()
+    clocks = node_clocks_per_packet(test, node)
+    test.assertGreater(clocks, 0, "%s did not run" % node)
+    return clocks
+
+
+def assert_clocks_within(test, results, a, b, factor):
+    """Log results and assert results[a] <= factor * results[b]."""
+    test.logger.info(
+        "clocks/packet: %s"
+        % ", ".join("%s %.1f" % (k, v) for k, v in sorted(results.items()))
+    )
+    test.assertLessEqual(
+        results[a],
+        factor * results[b],
+        "%s costs %.1f clocks/packet, over %.1fx %s's %.1f"
+        % (a, results[a], factor, b, results[b]),
+    )
@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""
+sonic_ext capture Tests
+
+Tests for sonic-ext-capture, the device-input feature that stamps the
+ingress port, outer VLAN tag and (with punt latency on) a timestamp
+into every packet received on an LCP phy, its on-demand mode, plus a
+pg benchmark of its cost per packet.
+"""
+
+import unittest
+from config import config
+from framework import VppTestCase
+from asfframework import VppTestRunner
+from node_bench import bench_node, node_clocks_per_packet, assert_clocks_within
+from vpp_l2 import L2_PORT_TYPE
+
+from scapy.layers.l2 import Ether
+from scapy.layers.inet import IP, UDP
+from scapy.packet import Raw
+
+CAPTURE = "/err/sonic-ext-capture/rx captured"
+BD_ID = 1
+
+
+class TestSonicExtCapture(VppTestCase):
+    """sonic_ext capture Test Case"""
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestSonicExtCapture, cls).setUpClass()
+        try:
+            cls.create_pg_interfaces(range(3))
+            for pg in cls.pg_interfaces[:2]:
+                pg.admin_up()
+                pg.config_ip4()
+                pg.resolve_arp()
+            # pg2 is for the on-demand test, which bridges it
+            cls.pg2.admin_up()
+
+            # pg0 becomes an LCP phy, so capture is on for it
+            reply = cls.vapi.sonic_ext_lcp_pair_add_del_bulk(
+                is_add=True,
+                n_pairs=1,
+                pairs=[
+                    {
+                        "phy_sw_if_index": cls.pg0.sw_if_index,
+                        "host_if_name": "hpg0",
+                    }
+                ],
+            )
+            if reply.retval:
+                raise Exception("LCP pair create failed: %d" % reply.retval)
+        except Exception:
+            cls.tearDownClass()
+            raise
+
+    @classmethod
+    def tearDownClass(cls):
+        if hasattr(cls, "pg0"):
+            cls.vapi.sonic_ext_lcp_pair_add_del_bulk(
+                is_add=False,
+                n_pairs=1,
+                pairs=[{"phy_sw_if_index": cls.pg0.sw_if_index}],
+            )
+        super(TestSonicExtCapture, cls).tearDownClass()
+
+    def tearDown(self):
+        self.vapi.sonic_ext_punt_latency_enable_disable(enable=False)
+        self.vapi.sonic_ext_capture_on_demand(enable=False)
+        super(TestSonicExtCapture, self).tearDown()
+
+    def show_commands_at_teardown(self):
+        self.logger.info(self.vapi.cli("show sonic-ext"))
+        self.logger.info(self.vapi.cli("show node counters"))
+
+    def create_transit_packet(self, size=60, rx=None, tx=None):
+        """64B (with FCS) IPv4/UDP from rx's peer routed out tx, by
+        default pg0 to pg1."""
+        rx = rx or self.pg0
+        tx = tx or self.pg1
+        pkt = (
+            Ether(src=rx.remote_mac, dst=rx.local_mac)
+            / IP(src=rx.remote_ip4, dst=tx.remote_ip4)
+            / UDP(sport=10000, dport=20000)
+        )
+        return pkt / Raw(b"\xa5" * max(0, size - len(pkt)))
+
+    def test_capture_on_lcp_phy(self):
+        """Capture stamps every packet received on an LCP phy"""
+        state = self.vapi.sonic_ext_get_state()
+        self.assertEqual(state.n_capture_ports, 1)
+
+        before = self.statistics.get_err_counter(CAPTURE)
+        pkts = [self.create_transit_packet()] * 17
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        self.pg1.get_capture(len(pkts))
+        self.assertEqual(self.statistics.get_err_counter(CAPTURE) - before, 17)
+
+    def assert_capture_ports(self, n):
+        """Bridge changes are picked up by the sync process's rescan,
+        once a second."""
+        for _ in range(30):
+            if self.vapi.sonic_ext_get_state().n_capture_ports == n:
+                return
+            self.sleep(0.1)
+        self.assertEqual(self.vapi.sonic_ext_get_state().n_capture_ports, n)
+
+    def test_capture_on_demand_follows_bridge(self):
+        """On-demand capture follows bridge membership"""
+        self.vapi.sonic_ext_lcp_pair_add_del_bulk(
+            is_add=True,
+            n_pairs=1,
+            pairs=[
+                {"phy_sw_if_index": self.pg2.sw_if_index, "host_if_name": "hpg2"}
+            ],
+        )
+        loop = self.create_loopback_interfaces(1)[0]
+        try:
+            self.vapi.sonic_ext_capture_on_demand(enable=True)
+            state = self.vapi.sonic_ext_get_state()
+            self.assertTrue(state.capture_on_demand)
+            # routed ports feed no aggregate
+            self.assertEqual(state.n_capture_ports, 0)
+
+            self.vapi.sw_interface_set_l2_bridge(
+                rx_sw_if_index=loop.sw_if_index,
+                bd_id=BD_ID,
+                port_type=L2_PORT_TYPE.BVI,
+            )
+            self.vapi.sw_interface_set_l2_bridge(
+                rx_sw_if_index=self.pg2.sw_if_index, bd_id=BD_ID
+            )
+            self.assert_capture_ports(1)
+
+            self.vapi.sw_interface_set_l2_bridge(
+                rx_sw_if_index=self.pg2.sw_if_index, bd_id=BD_ID, enable=0
+            )
+            self.assert_capture_ports(0)
+
+            self.vapi.sonic_ext_capture_on_demand(enable=False)
+            self.assertEqual(self.vapi.sonic_ext_get_state().n_capture_ports, 2)
+        finally:
+            self.vapi.sw_interface_set_l2_bridge(
+                rx_sw_if_index=self.pg2.sw_if_index, bd_id=BD_ID, enable=0
+            )
+            self.vapi.sw_interface_set_l2_bridge(
+                rx_sw_if_index=loop.sw_if_index,
+                bd_id=BD_ID,
+                port_type=L2_PORT_TYPE.BVI,
+                enable=0,
+            )
+            loop.remove_vpp_config()
+            self.vapi.sonic_ext_lcp_pair_add_del_bulk(
+                is_add=False,
+                n_pairs=1,
+                pairs=[{"phy_sw_if_index": self.pg2.sw_if_index}],
+            )
+
+    # ================================================================
+    # Benchmark
+    # ================================================================
+
+    @unittest.skipUnless(config.extended, "part of extended tests")
+    def test_capture_clocks_per_packet(self):
+        """sonic-ext-capture clocks/packet, against the receive path
+        of a port without it, latency off and on"""
+        pkt = self.create_transit_packet()
+        results = {}
+
+        # Baseline: the same stream received on pg1, no LCP phy, so no
+        # capture in front of ethernet-input.
+        results["baseline"] = bench_node(
+            self,
+            self.pg1,
+            self.create_transit_packet(rx=self.pg1, tx=self.pg0),
+            "ethernet-input",
+        )
+        results["capture"] = bench_node(self, self.pg0, pkt, "sonic-ext-capture")
+        results["ethernet-input"] = node_clocks_per_packet(self, "ethernet-input")
+        results["with capture"] = results["capture"] + results["ethernet-input"]
+
+        self.vapi.sonic_ext_punt_latency_enable_disable(enable=True)
+        results["capture+latency"] = bench_node(
+            self, self.pg0, pkt, "sonic-ext-capture"
+        )
+
+        # A handful of stores per packet: well below ethernet-input, so
+        # the device-input hop adds under half to the receive path, and
+        # the timestamp is read once per frame.
+        assert_clocks_within(self, results, "capture", "ethernet-input", 1.0)
+        assert_clocks_within(self, results, "with capture", "baseline", 1.5)
+        assert_clocks_within(self, results, "capture+latency", "capture", 1.5)
+
+
+if __name__ == "__main__":
+    unittest.main(testRunner=VppTestRunner)
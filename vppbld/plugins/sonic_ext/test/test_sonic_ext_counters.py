@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""
+sonic_ext counter Tests
+
+Tests for the sonic_ext stats-segment counters with worker threads:
+/sonic-ext/summary and the /sonic-ext/if/* per-interface counters keep
+one vector per thread, each worker counting what it handled, and
+sonic_ext_counters_dump returns the sum over all of them.
+"""
+
+import unittest
+from framework import VppTestCase
+from asfframework import VppTestRunner
+from vpp_l2 import L2_PORT_TYPE
+
+from scapy.layers.l2 import Ether
+from scapy.layers.inet import IP, UDP
+from scapy.packet import Raw
+
+BD_ID = 1
+
+# Index of "ip2me hits" in foreach_sonic_ext_counter.
+IP2ME_HITS = 5
+
+
+class TestSonicExtCounters(VppTestCase):
+    """sonic_ext multi-worker counter Test Case"""
+
+    vpp_worker_count = 2
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestSonicExtCounters, cls).setUpClass()
+        try:
+            cls.create_pg_interfaces(range(2))
+            for pg in cls.pg_interfaces:
+                pg.admin_up()
+                cls.vapi.sw_interface_set_l2_bridge(
+                    rx_sw_if_index=pg.sw_if_index, bd_id=BD_ID
+                )
+                cls.vapi.sonic_ext_ip2me_enable_disable(
+                    sw_if_index=pg.sw_if_index, enable=True
+                )
+
+            cls.create_loopback_interfaces(1)
+            cls.loop0 = cls.lo_interfaces[0]
+            cls.loop0.admin_up()
+            cls.loop0.config_ip4()
+            cls.vapi.sw_interface_set_l2_bridge(
+                rx_sw_if_index=cls.loop0.sw_if_index,
+                bd_id=BD_ID,
+                port_type=L2_PORT_TYPE.BVI,
+            )
+
+            # One ingress port per worker
+            for worker, pg in enumerate(cls.pg_interfaces):
+                cls.vapi.sw_interface_set_rx_placement(
+                    sw_if_index=pg.sw_if_index,
+                    queue_id=0,
+                    worker_id=worker,
+                    is_main=False,
+                )
+        except Exception:
+            cls.tearDownClass()
+            raise
+
+    @classmethod
+    def tearDownClass(cls):
+        for pg in getattr(cls, "pg_interfaces", []):
+            cls.vapi.sonic_ext_ip2me_enable_disable(
+                sw_if_index=pg.sw_if_index, enable=False
+            )
+        super(TestSonicExtCounters, cls).tearDownClass()
+
+    def show_commands_at_teardown(self):
+        self.logger.info(self.vapi.cli("show sonic-ext"))
+        self.logger.info(self.vapi.cli("show interface rx-placement"))
+
+    def create_ip2me_packets(self, pg, n):
+        """n IPv4/UDP packets to the BVI address bridged in on pg."""
+        return [
+            Ether(src=pg.remote_mac, dst=self.loop0.local_mac)
+            / IP(src=pg.remote_ip4, dst=self.loop0.local_ip4)
+            / UDP(sport=10000, dport=20000)
+            / Raw(b"\xa5" * 18)
+        ] * n
+
+    def ip2me_hits_total(self):
+        for d in self.vapi.sonic_ext_counters_dump():
+            if d.name == "ip2me hits":
+                return d.value
+        self.fail("ip2me hits not in sonic_ext_counters_dump")
+
+    def test_summary_per_worker(self):
+        """/sonic-ext/summary counts per worker, the dump sums them"""
+        n = {self.pg0: 17, self.pg1: 29}
+        before = self.statistics.get_counter("/sonic-ext/summary")
+        total_before = self.ip2me_hits_total()
+
+        for pg, count in n.items():
+            pg.add_stream(self.create_ip2me_packets(pg, count))
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+
+        after = self.statistics.get_counter("/sonic-ext/summary")
+
+        # main thread + one vector per worker, all of them sized
+        self.assertEqual(len(after), self.vpp_worker_count + 1)
+        for per_thread in after:
+            self.assertGreater(len(per_thread), IP2ME_HITS)
+
+        # worker w is thread w + 1; the main thread polls no pg
+        deltas = [
+            after[t][IP2ME_HITS] - before[t][IP2ME_HITS]
+            for t in range(len(after))
+        ]
+        self.assertEqual(deltas[0], 0)
+        self.assertEqual(deltas[1], n[self.pg0])
+        self.assertEqual(deltas[2], n[self.pg1])
+
+        self.assertEqual(
+            self.ip2me_hits_total() - total_before, sum(n.values())
+        )
+
+    def test_if_counters_sized_per_thread(self):
+        """Per-interface counters exist on every thread for every port"""
+        sub = self.vapi.create_vlan_subif(self.pg0.sw_if_index, 100)
+        try:
+            for name in (
+                "/sonic-ext/if/punt-redirects",
+                "/sonic-ext/if/host-xc",
+                "/sonic-ext/if/glean-throttled",
+            ):
+                counters = self.statistics.get_counter(name)
+                self.assertEqual(len(counters), self.vpp_worker_count + 1)
+                for per_thread in counters:
+                    # includes an interface created after startup
+                    self.assertGreater(len(per_thread), sub.sw_if_index)
+                    self.assertEqual(per_thread[sub.sw_if_index], 0)
+        finally:
+            self.vapi.delete_subif(sub.sw_if_index)
+
+
+if __name__ == "__main__":
+    unittest.main(testRunner=VppTestRunner)
@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+"""
+sonic_ext ip2me Tests
+
+Tests for the sonic-ext-ip2me-ip4 / sonic-ext-ip2me-ip6 nodes, which
+steer bridged traffic addressed to one of the switch's own addresses
+past any ingress ACL on the l2-input-ip* arcs, plus a pg benchmark of
+their cost per packet.
+"""
+
+import unittest
+from config import config
+from framework import VppTestCase
+from asfframework import VppTestRunner
+from vpp_l2 import L2_PORT_TYPE
+from vpp_ip_route import VppIpRoute, VppRoutePath, FibPathType
+from node_bench import bench_node, assert_clocks_within
+
+from scapy.layers.l2 import Ether
+from scapy.layers.inet import IP, UDP
+from scapy.layers.inet6 import IPv6
+from scapy.packet import Raw
+
+BD_ID = 1
+
+
+class TestSonicExtIp2me(VppTestCase):
+    """sonic_ext ip2me Test Case"""
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestSonicExtIp2me, cls).setUpClass()
+        try:
+            cls.create_pg_interfaces(range(2))
+            for pg in cls.pg_interfaces:
+                pg.admin_up()
+                cls.vapi.sw_interface_set_l2_bridge(
+                    rx_sw_if_index=pg.sw_if_index, bd_id=BD_ID
+                )
+
+            # BVI carrying the switch's addresses, as on a SONiC Vlan RIF
+            cls.create_loopback_interfaces(1)
+            cls.loop0 = cls.lo_interfaces[0]
+            cls.loop0.admin_up()
+            cls.loop0.config_ip4()
+            cls.loop0.config_ip6()
+            cls.vapi.sw_interface_set_l2_bridge(
+                rx_sw_if_index=cls.loop0.sw_if_index,
+                bd_id=BD_ID,
+                port_type=L2_PORT_TYPE.BVI,
+            )
+
+            cls.vapi.sonic_ext_ip2me_enable_disable(
+                sw_if_index=cls.pg0.sw_if_index, enable=True
+            )
+        except Exception:
+            cls.tearDownClass()
+            raise
+
+    @classmethod
+    def tearDownClass(cls):
+        if hasattr(cls, "pg0"):
+            cls.vapi.sonic_ext_ip2me_enable_disable(
+                sw_if_index=cls.pg0.sw_if_index, enable=False
+            )
+        super(TestSonicExtIp2me, cls).tearDownClass()
+
+    def show_commands_at_teardown(self):
+        self.logger.info(self.vapi.cli("show sonic-ext"))
+        self.logger.info(self.vapi.cli("show node counters"))
+
+    def create_ipv4_packet(self, dst_ip, size=None):
+        """Create an IPv4/UDP packet bridged in on pg0."""
+        pkt = (
+            Ether(src=self.pg0.remote_mac, dst=self.loop0.local_mac)
+            / IP(src=self.pg0.remote_ip4, dst=dst_ip)
+            / UDP(sport=10000, dport=20000)
+        )
+        if size:
+            pkt = pkt / Raw(b"\xa5" * max(0, size - len(pkt)))
+        return pkt
+
+    def create_ipv6_packet(self, dst_ip):
+        """Create an IPv6/UDP packet bridged in on pg0."""
+        return (
+            Ether(src=self.pg0.remote_mac, dst=self.loop0.local_mac)
+            / IPv6(src=self.pg0.remote_ip6, dst=dst_ip)
+            / UDP(sport=10000, dport=20000)
+            / Raw(b"\xa5" * 100)
+        )
+
+    def send_and_assert_counted(self, pkts, counter):
+        """Send pkts on pg0 and verify counter went up by len(pkts)."""
+        before = self.statistics.get_err_counter(counter)
+
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+
+        after = self.statistics.get_err_counter(counter)
+        self.assertEqual(
+            after - before,
+            len(pkts),
+            "%s counted %d of %d packets" % (counter, after - before, len(pkts)),
+        )
+
+    # ================================================================
+    # Classification
+    # ================================================================
+
+    def test_ip4_to_bvi_address_is_ip2me(self):
+        """IPv4 to the BVI address bypasses the ACL"""
+        self.send_and_assert_counted(
+            [self.create_ipv4_packet(self.loop0.local_ip4)],
+            "/err/sonic-ext-ip2me-ip4/ip2me frames bypassed the ACL",
+        )
+
+    def test_ip4_limited_broadcast_is_ip2me(self):
+        """IPv4 limited broadcast bypasses the ACL"""
+        self.send_and_assert_counted(
+            [self.create_ipv4_packet("255.255.255.255")],
+            "/err/sonic-ext-ip2me-ip4/ip2me frames bypassed the ACL",
+        )
+
+    def test_ip4_transit_passes_to_acl(self):
+        """IPv4 transit, including same-subnet, goes on to the ACL"""
+        self.send_and_assert_counted(
+            [
+                self.create_ipv4_packet("192.0.2.1"),
+                self.create_ipv4_packet(self.loop0.remote_ip4),
+            ],
+            "/err/sonic-ext-ip2me-ip4/frames passed through to the ACL",
+        )
+
+    def test_ip4_receive_route_is_ip2me(self):
+        """IPv4 to a "via local" route, not an interface address, too"""
+        route = VppIpRoute(
+            self,
+            "198.51.100.9",
+            32,
+            [
+                VppRoutePath(
+                    "0.0.0.0", 0xFFFFFFFF, type=FibPathType.FIB_PATH_TYPE_LOCAL
+                )
+            ],
+        )
+        route.add_vpp_config()
+        try:
+            self.send_and_assert_counted(
+                [self.create_ipv4_packet("198.51.100.9")],
+                "/err/sonic-ext-ip2me-ip4/ip2me frames bypassed the ACL",
+            )
+        finally:
+            route.remove_vpp_config()
+
+    def test_ip6_to_bvi_address_is_ip2me(self):
+        """IPv6 to the BVI address bypasses the ACL"""
+        self.send_and_assert_counted(
+            [self.create_ipv6_packet(self.loop0.local_ip6)],
+            "/err/sonic-ext-ip2me-ip6/ip2me frames bypassed the ACL",
+        )
+
+    def test_ip6_transit_passes_to_acl(self):
+        """IPv6 transit goes on to the ACL"""
+        self.send_and_assert_counted(
+            [self.create_ipv6_packet("2001:db8:ffff::1")],
+            "/err/sonic-ext-ip2me-ip6/frames passed through to the ACL",
+        )
+
+    def test_address_removal_is_tracked(self):
+        """A removed address stops being ip2me"""
+        self.vapi.sw_interface_add_del_address(
+            sw_if_index=self.loop0.sw_if_index, prefix="198.51.100.1/32"
+        )
+        self.send_and_assert_counted(
+            [self.create_ipv4_packet("198.51.100.1")],
+            "/err/sonic-ext-ip2me-ip4/ip2me frames bypassed the ACL",
+        )
+        self.vapi.sw_interface_add_del_address(
+            sw_if_index=self.loop0.sw_if_index,
+            prefix="198.51.100.1/32",
+            is_add=0,
+        )
+        self.send_and_assert_counted(
+            [self.create_ipv4_packet("198.51.100.1")],
+            "/err/sonic-ext-ip2me-ip4/frames passed through to the ACL",
+        )
+
+    # ================================================================
+    # Benchmark
+    # ================================================================
+
+    @unittest.skipUnless(config.extended, "part of extended tests")
+    def test_ip4_clocks_per_packet(self):
+        """sonic-ext-ip2me-ip4 clocks/packet, 64B transit vs ip2me"""
+        node = "sonic-ext-ip2me-ip4"
+        results = {
+            name: bench_node(
+                self, self.pg0, self.create_ipv4_packet(dst, size=60), node
+            )
+            for name, dst in (
+                ("transit", "192.0.2.1"),
+                ("ip2me", self.loop0.local_ip4),
+            )
+        }
+
+        # ip2me to an interface address is one table probe; transit adds
+        # the LPM that rules out other receive routes, no more.
+        assert_clocks_within(self, results, "ip2me", "transit", 1.0)
+        assert_clocks_within(self, results, "transit", "ip2me", 2.0)
+
+
+if __name__ == "__main__":
+    unittest.main(testRunner=VppTestRunner)
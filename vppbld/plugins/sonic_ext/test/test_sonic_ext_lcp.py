@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""
+sonic_ext bulk LCP Tests
+
+Tests for sonic_ext_lcp_pair_add_del_bulk with host tap offloads: gso
+turns on GSO and checksum offload on the new taps, gro also coalesces
+TCP into them.
+"""
+
+import unittest
+from framework import VppTestCase
+from asfframework import VppTestRunner
+from vpp_papi import VppEnum
+
+
+class TestSonicExtLcp(VppTestCase):
+    """sonic_ext bulk LCP Test Case"""
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestSonicExtLcp, cls).setUpClass()
+        try:
+            cls.create_pg_interfaces(range(2))
+            for pg in cls.pg_interfaces:
+                pg.admin_up()
+        except Exception:
+            cls.tearDownClass()
+            raise
+
+    def show_commands_at_teardown(self):
+        self.logger.info(self.vapi.cli("show lcp"))
+        self.logger.info(self.vapi.cli("show tap"))
+
+    def pairs_add_del(self, is_add, **offload):
+        pairs = [
+            {"phy_sw_if_index": pg.sw_if_index, "host_if_name": "h" + pg.name}
+            for pg in self.pg_interfaces
+        ]
+        reply = self.vapi.sonic_ext_lcp_pair_add_del_bulk(
+            is_add=is_add, n_pairs=len(pairs), pairs=pairs, **offload
+        )
+        self.assertEqual(reply.retval, 0)
+        self.assertEqual(len(reply.status), len(pairs))
+        for status in reply.status:
+            self.assertEqual(status.retval, 0)
+        return reply
+
+    def assert_tap_flags(self, reply, want, not_want=0):
+        taps = {
+            t.sw_if_index: t.tap_flags for t in self.vapi.sw_interface_tap_v2_dump()
+        }
+        for status in reply.status:
+            flags = taps[status.host_sw_if_index]
+            self.assertEqual(flags & want, want)
+            self.assertEqual(flags & not_want, 0)
+
+    def test_create_gso(self):
+        """Bulk create with gso: the host taps report GSO"""
+        flags = VppEnum.vl_api_tap_flags_t
+        reply = self.pairs_add_del(True, gso=True)
+        try:
+            self.assert_tap_flags(
+                reply,
+                flags.TAP_API_FLAG_GSO,
+                flags.TAP_API_FLAG_GRO_COALESCE,
+            )
+        finally:
+            self.pairs_add_del(False)
+
+    def test_create_gro(self):
+        """Bulk create with gro: the host taps report GSO and GRO"""
+        flags = VppEnum.vl_api_tap_flags_t
+        reply = self.pairs_add_del(True, gro=True)
+        try:
+            self.assert_tap_flags(
+                reply,
+                flags.TAP_API_FLAG_GSO | flags.TAP_API_FLAG_GRO_COALESCE,
+            )
+        finally:
+            self.pairs_add_del(False)
+
+
+if __name__ == "__main__":
+    unittest.main(testRunner=VppTestRunner)
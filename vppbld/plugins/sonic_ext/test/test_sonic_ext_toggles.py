@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""
+sonic_ext toggle Tests
+
+Once wired, punt-via-member and host-xc are switched by a flag store:
+their thread-safe API messages must not take the worker barrier.  The
+barrier is counted in the event log ("elog trace barrier"), so the
+test also reports what a toggle costs in barrier syncs.
+"""
+
+import unittest
+from framework import VppTestCase
+from asfframework import VppTestRunner
+
+N_TOGGLES = 20
+
+
+class TestSonicExtToggles(VppTestCase):
+    """sonic_ext barrier-free toggle Test Case"""
+
+    # The barrier is a no-op without workers.
+    vpp_worker_count = 1
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestSonicExtToggles, cls).setUpClass()
+        cls.vapi.cli("elog trace barrier")
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.vapi.cli("elog trace disable")
+        super(TestSonicExtToggles, cls).tearDownClass()
+
+    def tearDown(self):
+        self.vapi.sonic_ext_punt_via_member_enable_disable(enable=True)
+        self.vapi.sonic_ext_host_xc_enable_disable(enable=True)
+        super(TestSonicExtToggles, self).tearDown()
+
+    def barrier_syncs(self, toggle, n):
+        """Barrier syncs logged around n on/off toggles.  The CLI calls
+        that clear and read the log take it too; only the difference
+        between two runs is the toggles' own."""
+        self.vapi.cli("event-logger clear")
+        for i in range(n):
+            toggle(enable=(i % 2 == 1))
+        log = self.vapi.cli("show event-logger all")
+        return sum("bar-trace" in line for line in log.splitlines())
+
+    def assert_toggle_barrier_free(self, name, toggle):
+        # wire the feature, in case nothing has yet
+        toggle(enable=True)
+
+        base = self.barrier_syncs(toggle, 0)
+        self.assertGreater(base, 0, "barrier events not in the event log")
+        syncs = self.barrier_syncs(toggle, N_TOGGLES)
+
+        self.logger.info(
+            "%s: %d barrier events for %d toggles, %d for none"
+            % (name, syncs, N_TOGGLES, base)
+        )
+        self.assertEqual(syncs, base)
+
+    def test_punt_via_member_toggle(self):
+        """punt-via-member on/off does not take the worker barrier"""
+        self.assert_toggle_barrier_free(
+            "punt-via-member",
+            self.vapi.sonic_ext_punt_via_member_enable_disable,
+        )
+
+    def test_host_xc_toggle(self):
+        """host-xc on/off does not take the worker barrier"""
+        self.assert_toggle_barrier_free(
+            "host-xc", self.vapi.sonic_ext_host_xc_enable_disable
+        )
+
+
+if __name__ == "__main__":
+    unittest.main(testRunner=VppTestRunner)
@@ -1,5 +1,6 @@
 #!/usr/bin/env python3
 
+import platform
 import unittest
 from framework import VppTestCase
 from asfframework import VppTestRunner
@@ -529,6 +530,16 @@ class TestTuntermAcl(VppTestCase):
 
         self.remove_configured_vpp_objects_on_tear_down = False
 
+    def test_node_variants(self):
+        """tunterm nodes are registered with per-CPU march variants"""
+        if platform.machine() != "x86_64":
+            self.skipTest("march variant names below are x86 specific")
+        for node in ("tunterm-acl", "tunterm-ip4-vxlan-bypass"):
+            reply = self.vapi.cli("show node %s" % node)
+            self.assertIn("node function variants", reply)
+            self.assertIn("hsw", reply, f"{node} has no AVX2 variant")
+        self.remove_configured_vpp_objects_on_tear_down = False
+
 
 TestTuntermAcl.add_dynamic_tests()
 
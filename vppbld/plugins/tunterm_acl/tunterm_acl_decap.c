@@ -21,7 +21,12 @@
 
 #include <vnet/plugin/plugin.h>
 
+/* Resolved once from vxlan_plugin.so at init time.  Defined only in the
+ * baseline object so every march variant of the node shares it. */
+extern vxlan_main_t *tunterm_acl_vxlan_main;
+#ifndef CLIB_MARCH_VARIANT
 vxlan_main_t *tunterm_acl_vxlan_main;
+#endif
 
 typedef enum
 {
@@ -45,7 +50,7 @@ static const vxlan_decap_info_t decap_bad_flags = { .sw_if_index = ~0,
 						    .error =
 						      VXLAN_ERROR_BAD_FLAGS };
 
-vxlan_decap_info_t
+always_inline vxlan_decap_info_t
 tunterm_acl_vxlan4_find_tunnel (vxlan_main_t *vxm, last_tunnel_cache4 *cache,
 				u32 fib_index, ip4_header_t *ip4_0,
 				vxlan_header_t *vxlan0, u32 *stats_sw_if_index)